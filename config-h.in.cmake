@@ -18,6 +18,7 @@
 #cmakedefine LITTLEEND 1
 #cmakedefine BIGEND 1
 #cmakedefine TIRPC_EPOLL 1
+#cmakedefine TIRPC_IO_URING 1
 #cmakedefine USE_RPC_RDMA 1
 #cmakedefine USE_LTTNG_NTIRPC 1
 
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2019 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timing wheel
+ *
+ * @section DESCRIPTION
+ *
+ * Four levels of 64 slots, with a tick of one millisecond.  Level L
+ * holds entries due within 64^(L+1) ticks, in the slot of their tick
+ * shifted by 6L bits.  Each slot of a higher level is cascaded into
+ * the lower levels when the wheel reaches the start of its block, so
+ * every entry is moved at most three times.  Entries beyond the top
+ * level (about 4.6 hours) wait in its furthest slot, and are placed
+ * again when it cascades.
+ *
+ * Insert and remove are O(1).  Occupancy bitmaps find the next slot
+ * to be processed without scanning, so an idle wheel is skipped in
+ * one step.
+ *
+ * Not locked:  the caller serializes access.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <misc/queue.h>
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SPAN (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+#define TIMER_WHEEL_IDLE UINT16_MAX
+
+struct timer_wheel_entry {
+	TAILQ_ENTRY(timer_wheel_entry) twe_q;
+	uint64_t twe_expire;	/* tick (ms) */
+	uint16_t twe_slot;	/* or TIMER_WHEEL_IDLE */
+};
+
+TAILQ_HEAD(timer_wheel_list, timer_wheel_entry);
+
+struct timer_wheel {
+	uint64_t tw_now;	/* last tick processed */
+	uint64_t tw_map[TIMER_WHEEL_LEVELS];	/* occupied slots */
+	uint32_t tw_count;
+	struct timer_wheel_list tw_slot[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SIZE];
+};
+
+static inline void
+timer_wheel_init(struct timer_wheel *tw, uint64_t now)
+{
+	int ix;
+
+	tw->tw_now = now;
+	tw->tw_count = 0;
+	for (ix = 0; ix < TIMER_WHEEL_LEVELS; ix++)
+		tw->tw_map[ix] = 0;
+	for (ix = 0; ix < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SIZE; ix++)
+		TAILQ_INIT(&tw->tw_slot[ix]);
+}
+
+static inline void
+timer_wheel_entry_init(struct timer_wheel_entry *twe)
+{
+	twe->twe_slot = TIMER_WHEEL_IDLE;
+}
+
+static inline bool
+timer_wheel_pending(struct timer_wheel_entry *twe)
+{
+	return (twe->twe_slot != TIMER_WHEEL_IDLE);
+}
+
+static inline void
+timer_wheel_place(struct timer_wheel *tw, struct timer_wheel_entry *twe)
+{
+	uint64_t expire = twe->twe_expire;
+	uint64_t delta = expire - tw->tw_now;
+	int level = 0;
+	int ix;
+
+	if (delta >= TIMER_WHEEL_SPAN) {
+		/* furthest slot, placed again on cascade */
+		expire = tw->tw_now + TIMER_WHEEL_SPAN - 1;
+		delta = TIMER_WHEEL_SPAN - 1;
+	}
+	while (delta >= TIMER_WHEEL_SIZE) {
+		delta >>= TIMER_WHEEL_BITS;
+		level++;
+	}
+	ix = (expire >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+
+	twe->twe_slot = level * TIMER_WHEEL_SIZE + ix;
+	TAILQ_INSERT_TAIL(&tw->tw_slot[twe->twe_slot], twe, twe_q);
+	tw->tw_map[level] |= 1ULL << ix;
+}
+
+/*
+ * Entries due at or before the last tick processed fire on the next.
+ */
+static inline void
+timer_wheel_insert(struct timer_wheel *tw, struct timer_wheel_entry *twe,
+		   uint64_t expire)
+{
+	twe->twe_expire = (expire > tw->tw_now) ? expire : tw->tw_now + 1;
+	timer_wheel_place(tw, twe);
+	tw->tw_count++;
+}
+
+/*
+ * Idempotent:  returns false when the entry was not pending.
+ */
+static inline bool
+timer_wheel_remove(struct timer_wheel *tw, struct timer_wheel_entry *twe)
+{
+	struct timer_wheel_list *slot;
+	int slot_ix = twe->twe_slot;
+
+	if (slot_ix == TIMER_WHEEL_IDLE)
+		return false;
+
+	slot = &tw->tw_slot[slot_ix];
+	TAILQ_REMOVE(slot, twe, twe_q);
+	if (TAILQ_EMPTY(slot))
+		tw->tw_map[slot_ix / TIMER_WHEEL_SIZE] &=
+			~(1ULL << (slot_ix & TIMER_WHEEL_MASK));
+	twe->twe_slot = TIMER_WHEEL_IDLE;
+	tw->tw_count--;
+	return true;
+}
+
+/*
+ * The next tick after tw_now at which a slot must be processed, either
+ * expired or cascaded, or UINT64_MAX when empty.
+ */
+static inline uint64_t
+timer_wheel_next(struct timer_wheel *tw)
+{
+	uint64_t next = UINT64_MAX;
+	uint64_t map;
+	uint64_t tick;
+	int shift;
+	int level;
+	int cur;
+
+	if (!tw->tw_count)
+		return (next);
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		map = tw->tw_map[level];
+		if (!map)
+			continue;
+
+		/* slots after the current one, wrapping to it last */
+		shift = TIMER_WHEEL_BITS * level;
+		cur = ((tw->tw_now >> shift) + 1) & TIMER_WHEEL_MASK;
+		if (cur)
+			map = (map >> cur) | (map << (TIMER_WHEEL_SIZE - cur));
+		tick = ((tw->tw_now >> shift) + 1 + __builtin_ctzll(map))
+			<< shift;
+		if (tick < next)
+			next = tick;
+	}
+	return (next);
+}
+
+static inline void
+timer_wheel_cascade(struct timer_wheel *tw, int level, int ix)
+{
+	struct timer_wheel_list *slot =
+		&tw->tw_slot[level * TIMER_WHEEL_SIZE + ix];
+	struct timer_wheel_entry *twe;
+
+	tw->tw_map[level] &= ~(1ULL << ix);
+	while ((twe = TAILQ_FIRST(slot))) {
+		TAILQ_REMOVE(slot, twe, twe_q);
+		timer_wheel_place(tw, twe);
+	}
+}
+
+/*
+ * Advance to now, moving entries that are due onto the expired list.
+ * Returns the milliseconds until the next tick to be processed, at most
+ * max_ms.
+ */
+static inline int
+timer_wheel_expire(struct timer_wheel *tw, uint64_t now,
+		   struct timer_wheel_list *expired, int max_ms)
+{
+	struct timer_wheel_list *slot;
+	struct timer_wheel_entry *twe;
+	uint64_t next;
+	int level;
+	int ix;
+
+	for (;;) {
+		next = timer_wheel_next(tw);
+		if (next > now)
+			break;
+
+		tw->tw_now = next;
+		for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+			if (next & ((1ULL << (TIMER_WHEEL_BITS * level)) - 1))
+				break;
+			ix = (next >> (TIMER_WHEEL_BITS * level))
+				& TIMER_WHEEL_MASK;
+			if (tw->tw_map[level] & (1ULL << ix))
+				timer_wheel_cascade(tw, level, ix);
+		}
+
+		ix = next & TIMER_WHEEL_MASK;
+		if (!(tw->tw_map[0] & (1ULL << ix)))
+			continue;
+
+		slot = &tw->tw_slot[ix];
+		tw->tw_map[0] &= ~(1ULL << ix);
+		while ((twe = TAILQ_FIRST(slot))) {
+			TAILQ_REMOVE(slot, twe, twe_q);
+			twe->twe_slot = TIMER_WHEEL_IDLE;
+			tw->tw_count--;
+			TAILQ_INSERT_TAIL(expired, twe, twe_q);
+		}
+	}
+	if (now > tw->tw_now)
+		tw->tw_now = now;
+
+	if (next - now < (uint64_t)max_ms)
+		return (next - now);
+	return (max_ms);
+}
+
+#endif				/* TIMER_WHEEL_H */
@@ -49,6 +49,7 @@
 #define _TIRPC_CLNT_H_
 
 #include <misc/rbtree.h>
+#include <misc/timer_wheel.h>
 #include <misc/wait_queue.h>
 #include <rpc/svc.h>
 #include <rpc/rpc_err.h>
@@ -131,7 +132,7 @@ typedef struct rpc_client {
 struct clnt_req {
 	struct work_pool_entry cc_wpe;
 	struct opr_rbtree_node cc_dplx;
-	struct opr_rbtree_node cc_rqst;
+	struct timer_wheel_entry cc_rqst;	/* size of opr_rbtree_node */
 	struct waitq_entry cc_we;
 	struct opaque_auth cc_verf;
 
@@ -144,7 +145,7 @@ struct clnt_req {
 	struct timespec cc_timeout;
 	struct rpc_err cc_error;
 	size_t cc_size;
-	int cc_expire_ms;
+	int cc_expire_ms;	/* unused, keeps the layout */
 	int cc_refreshes;
 	rpcproc_t cc_proc;
 	uint32_t cc_xid;
@@ -562,6 +563,7 @@ static inline void clnt_req_fill(struct clnt_req *cc, struct rpc_client *clnt,
 
 	cc->cc_size = sizeof(*cc);
 	cc->cc_refcnt = 1;
+	timer_wheel_entry_init(&cc->cc_rqst);
 
 	/* protects this */
 	pthread_mutex_init(&cc->cc_we.mtx, NULL);
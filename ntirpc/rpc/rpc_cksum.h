@@ -45,8 +45,37 @@
 #ifndef RPC_CKSUM_H
 #define RPC_CKSUM_H
 
-/* table-driven, software crc32c */
+#include <stdbool.h>
+#include <rpc/types.h>
+
+/* crc32c, in hardware where the CPU has it */
 uint32_t calculate_crc32c(uint32_t crc32c, const unsigned char *buffer,
 			  unsigned int length);
 
+/*
+ * Request checksums (rq_cksum), for duplicate request caches
+ */
+enum rpc_cksum_type {
+	RPC_CKSUM_CITY64,	/* CityHash64 (default) */
+	RPC_CKSUM_CRC32C,	/* crc32c, length in the high word */
+	RPC_CKSUM_XXH64,	/* XXH64 */
+};
+
+enum rpc_cksum_cover {
+	RPC_CKSUM_PREFIX,	/* the first len bytes (default 256) */
+	RPC_CKSUM_FULL,		/* every byte */
+	RPC_CKSUM_SAMPLED,	/* the first len bytes, samples of 64 bytes
+				 * spread over the rest, and the length */
+};
+
+struct rpc_cksum_params {
+	enum rpc_cksum_type type;
+	enum rpc_cksum_cover cover;
+	u_int len;		/* prefix or header bytes, up to 65535 */
+	u_int samples;		/* RPC_CKSUM_SAMPLED, 1 to 255 */
+};
+
+/* program 0 sets the default for programs not set */
+bool svc_cksum_set(rpcprog_t prog, const struct rpc_cksum_params *params);
+
 #endif				/* RPC_CKSUM_H */
@@ -92,6 +92,15 @@ enum xprt_stat {
 #define SVC_INIT_EPOLL          0x0002
 #define SVC_INIT_NOREG_XPRTS    0x0008
 #define SVC_INIT_BLKIN          0x0010
+#define SVC_INIT_IO_URING       0x0020
+#define SVC_INIT_VC_DRAIN       0x0040
+#define SVC_INIT_ZEROCOPY       0x0080
+#define SVC_INIT_NONBLOCK_OUT   0x0100
+#define SVC_INIT_DG_BATCH       0x0200
+#define SVC_INIT_CPU_AFFINITY   0x0400
+#define SVC_INIT_NUMA_AFFINITY  0x0800
+#define SVC_INIT_BUSY_POLL      0x1000
+#define SVC_INIT_SENDQ_BUDGET   0x2000
 
 #define SVC_SHUTDOWN_FLAG_NONE  0x0000
 
@@ -136,11 +145,49 @@ typedef struct svc_init_params {
 	u_int gss_max_gc;
 	uint32_t channels;
 	int32_t idle_timeout;
+
+	/* SVC_INIT_SENDQ_BUDGET queued stream output (bytes).  Over budget,
+	 * receiving pauses on the transport until half drained; over twice
+	 * the budget, more replies are dropped.  Without the flag, or 0:
+	 * SVC_SENDQ_BUDGET_DEFAULT per transport, no global budget.
+	 */
+	uint64_t ioq_sendq_budget;	/* per transport */
+	uint64_t ioq_sendq_global;	/* all transports */
+
+	/* SVC_INIT_DG_BATCH datagrams per receive or send call.
+	 * 0: SVC_DG_BATCH_DEFAULT, at most SVC_DG_BATCH_MAX.
+	 */
+	u_int dg_batch;
+
+	/* SVC_INIT_BUSY_POLL epoll channels poll without waiting for up to
+	 * this long (usec) after events, adapting to the traffic.
+	 * 0: SVC_BUSY_POLL_DEFAULT, at most SVC_BUSY_POLL_MAX.
+	 */
+	u_int busy_poll_us;
 } svc_init_params;
 
+#define SVC_SENDQ_BUDGET_DEFAULT (32 * 1024 * 1024)
+#define SVC_DG_BATCH_DEFAULT 16
+#define SVC_DG_BATCH_MAX 64
+#define SVC_BUSY_POLL_DEFAULT 50
+#define SVC_BUSY_POLL_MAX 10000
+
+/* stream output counters */
+struct svc_sendq_stats {
+	uint64_t bytes;			/* queued, all transports */
+	uint64_t drops;			/* replies dropped over budget */
+	uint64_t pauses;		/* receive paused over budget */
+};
+
 /* Svc param flags */
 #define SVC_FLAG_NONE             0x0000
 #define SVC_FLAG_NOREG_XPRTS      0x0001
+#define SVC_FLAG_VC_DRAIN         0x0002
+#define SVC_FLAG_ZEROCOPY         0x0004
+#define SVC_FLAG_NONBLOCK_OUT     0x0008
+#define SVC_FLAG_DG_BATCH         0x0010
+#define SVC_FLAG_AFFINITY         0x0020
+#define SVC_FLAG_BUSY_POLL        0x0040
 
 /*
  * SVCXPRT xp_flags
@@ -156,6 +203,8 @@ typedef struct svc_init_params {
 #define SVC_XPRT_FLAG_DESTROYING	0x0020	/* SVC_DESTROY() was called */
 #define SVC_XPRT_FLAG_RELEASING		0x0040	/* (*xp_destroy) was called */
 #define SVC_XPRT_FLAG_UREG		0x0080
+#define SVC_XPRT_FLAG_BLOCKED		0x0100	/* output waiting for POLLOUT */
+#define SVC_XPRT_FLAG_PAUSED		0x0200	/* output over budget */
 
 #define SVC_XPRT_FLAG_DESTROYED (SVC_XPRT_FLAG_DESTROYING \
 				| SVC_XPRT_FLAG_RELEASING)
@@ -476,6 +525,7 @@ __BEGIN_DECLS
 extern struct work_pool svc_work_pool;
 
 bool svc_init(struct svc_init_params *);
+void svc_sendq_get_stats(struct svc_sendq_stats *);
 __END_DECLS
 /*
  * Service shutdown (optional).
@@ -623,6 +673,29 @@ extern SVCXPRT *svc_tli_ncreate(const int, const struct netconfig *,
  *      const u_int sendsz;             -- max sendsize
  *      const u_int recvsz;             -- max recvsize
  */
+
+/*
+ * SO_REUSEPORT listeners, one per event channel
+ */
+#define SVC_REUSEPORT_FLAG_NONE		0x0000
+#define SVC_REUSEPORT_FLAG_EVCHAN	0x0001	/* new channels, ids OUT */
+#define SVC_REUSEPORT_FLAG_CPU		0x0002	/* steer by receiving CPU */
+
+extern int svc_reuseport_ncreate(const struct netconfig *,
+				 const struct t_bind *, const u_int,
+				 const u_int, const u_int, uint32_t *,
+				 SVCXPRT **, svc_xprt_fun_t, const uint32_t);
+/*
+ *      const struct netconfig *nconf;  -- netconfig structure for network
+ *      const struct t_bind *bindaddr;  -- shared local bind address
+ *      const u_int sendsz;             -- max sendsize
+ *      const u_int recvsz;             -- max recvsize
+ *      const u_int count;              -- number of sockets
+ *      uint32_t *chan_ids;             -- event channel per socket
+ *      SVCXPRT **xprts;                -- OUT: transport per socket
+ *      svc_xprt_fun_t rendezvous_cb;   -- set before registration
+ *      const uint32_t flags;           -- SVC_REUSEPORT_FLAG_*
+ */
 __END_DECLS
 
 /*
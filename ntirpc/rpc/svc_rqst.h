@@ -36,10 +36,13 @@
  *
  *  svc_rqst_init -- init module; usually called by svc_init()
  *  svc_rqst_new_evchan -- create event channel
+ *  svc_rqst_new_evchan_pool -- create event channel with its own workers
+ *  svc_rqst_new_evchan_shared -- create event channel sharing those workers
  *  svc_rqst_evchan_reg -- set {xprt, dispatcher} mapping
  *  svc_rqst_foreach_xprt -- scan registered xprts at id (or 0 for all)
  *  svc_rqst_thrd_signal -- request thread to run a callout function
  *			 (which can cause the thread to return)
+ *  svc_rqst_get_stats -- event channel counters
  *  svc_rqst_shutdown -- cause all threads to return
  */
 
@@ -47,6 +50,7 @@
 #define TIRPC_SVC_RQST_H
 
 #include <rpc/svc.h>
+#include <rpc/work_pool.h>
 
 #define SVC_RQST_FLAG_NONE		SVC_XPRT_FLAG_NONE
 /* uint16_t actually used */
@@ -59,13 +63,29 @@
 #define SVC_RQST_FLAG_LOCKED		SVC_XPRT_FLAG_LOCKED
 #define SVC_RQST_FLAG_UNLOCK		SVC_XPRT_FLAG_UNLOCK
 #define SVC_RQST_FLAG_EPOLL		0x00080000
+#define SVC_RQST_FLAG_IO_URING		0x00100000
+#define SVC_RQST_FLAG_AFFINITY		0x00400000 /* near a CPU and node */
+
+/* event channel counters */
+struct svc_rqst_stats {
+	uint64_t ev_sigs;		/* wakeups signalled */
+	uint64_t ev_sigs_coalesced;	/* wakeups saved by coalescing */
+	uint64_t ev_busy_hits;		/* events found while busy polling */
+	uint64_t ev_busy_misses;	/* busy poll windows ended idle */
+};
 
 void svc_rqst_init(uint32_t);
 int svc_rqst_new_evchan(uint32_t *chan_id /* OUT */ , void *u_data,
 			uint32_t flags);
+int svc_rqst_new_evchan_pool(uint32_t *chan_id /* OUT */ , void *u_data,
+			     uint32_t flags,
+			     const struct work_pool_params *params);
+int svc_rqst_new_evchan_shared(uint32_t *chan_id /* OUT */ , void *u_data,
+			       uint32_t flags, uint32_t pool_chan_id);
 int svc_rqst_evchan_reg(uint32_t chan_id, SVCXPRT *xprt, uint32_t flags);
 
 int svc_rqst_thrd_signal(uint32_t chan_id, uint32_t flags);
+int svc_rqst_get_stats(uint32_t chan_id, struct svc_rqst_stats *stats);
 void svc_rqst_shutdown(void);
 
 /* iterator callback prototype */
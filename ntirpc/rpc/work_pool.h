@@ -33,6 +33,14 @@
  *
  * This provides simple work queues using pthreads and TAILQ primitives.
  *
+ * Each worker has its own local queue for work submitted by that worker.
+ * Idle workers steal from busy ones.  The pool head is the global overflow
+ * queue for work submitted from outside the pool (or when a local queue
+ * is full), and holds the waiting workers.
+ *
+ * Workers may be bound to CPUs or NUMA nodes (WORK_POOL_FLAG_*), and
+ * work_pool_submit_near() prefers waiting workers bound near the caller.
+ *
  * @note    Loosely based upon previous thrdpool by
  *          Matt Benjamin <matt@cohortfs.com>
  */
@@ -45,17 +53,30 @@
 struct work_pool_params {
 	int32_t thrd_max;
 	int32_t thrd_min;
+	uint32_t flags;
 };
 
+/* work_pool_params flags */
+#define WORK_POOL_FLAG_NONE	0x0000
+#define WORK_POOL_FLAG_CPU	0x0001	/* each worker bound to one CPU */
+#define WORK_POOL_FLAG_NUMA	0x0002	/* each worker bound to one node */
+
 struct work_pool_thread;
 
-struct work_pool {
+struct work_pool_localq {
 	struct poolq_head pqh;
+	struct work_pool_thread *wpt;	/* owner, NULL when unused */
+};
+
+struct work_pool {
+	struct poolq_head pqh;		/* global overflow, waiting workers */
 	TAILQ_HEAD(work_pool_s, work_pool_thread) wptqh;
+	struct work_pool_localq *localq;	/* one per possible worker */
 	char *name;
 	pthread_attr_t attr;
 	struct work_pool_params params;
 	long timeout_ms;
+	uint32_t n_localq;
 	uint32_t n_threads;
 	uint32_t worker_index;
 };
@@ -68,10 +89,13 @@ struct work_pool_thread {
 	pthread_cond_t pqcond;
 
 	struct work_pool *pool;
+	struct work_pool_localq *localq;
 	struct work_pool_entry *work;
 	char worker_name[16];
 	pthread_t pt;
 	uint32_t worker_index;
+	int32_t cpu;			/* bound CPU, or -1 */
+	int32_t node;			/* bound NUMA node, or -1 */
 };
 
 typedef void (*work_pool_fun_t) (struct work_pool_entry *);
@@ -85,6 +109,12 @@ struct work_pool_entry {
 
 int work_pool_init(struct work_pool *, const char *, struct work_pool_params *);
 int work_pool_submit(struct work_pool *, struct work_pool_entry *);
+int work_pool_submit_batch(struct work_pool *, struct work_pool_entry **,
+			   int);
+int work_pool_submit_near(struct work_pool *, struct work_pool_entry **,
+			  int, int32_t, int32_t);
+int32_t work_pool_cpu(uint32_t);
+int32_t work_pool_cpu_node(int32_t);
 int work_pool_shutdown(struct work_pool *);
 
 #endif				/* WORK_POOL_H */
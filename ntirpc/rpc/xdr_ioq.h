@@ -99,12 +99,15 @@ struct xdr_ioq {
 /* ioq_s.qflags */
 #define IOQ_FLAG_SEGMENT	0x0100
 #define IOQ_FLAG_WORKING	0x0200	/* (atomic) using ioq_wpe */
+#define IOQ_FLAG_RECYCLE	0x0400	/* from xdr_ioq_create_cached() */
 /* uint32_t instructions */
 #define IOQ_FLAG_LOCKED		0x00010000
 #define IOQ_FLAG_UNLOCK		0x00020000
 #define IOQ_FLAG_BALLOC		0x00040000
 
 extern struct xdr_ioq_uv *xdr_ioq_uv_create(size_t size, u_int uio_flags);
+extern struct xdr_ioq_uv *xdr_ioq_uv_bufq_create(size_t size,
+						 u_int uio_flags);
 extern struct poolq_entry *xdr_ioq_uv_fetch(struct xdr_ioq *xioq,
 					     struct poolq_head *ioqh,
 					     char *comment,
@@ -119,6 +122,9 @@ extern void xdr_ioq_uv_release(struct xdr_ioq_uv *uv);
 
 extern struct xdr_ioq *xdr_ioq_create(size_t min_bsize, size_t max_bsize,
 				      u_int uio_flags);
+extern struct xdr_ioq *xdr_ioq_create_cached(size_t min_bsize,
+					     size_t max_bsize,
+					     u_int uio_flags);
 extern void xdr_ioq_release(struct poolq_head *ioqh);
 extern void xdr_ioq_reset(struct xdr_ioq *xioq, u_int wh_pos);
 extern void xdr_ioq_setup(struct xdr_ioq *xioq);
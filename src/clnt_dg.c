@@ -225,11 +225,12 @@ clnt_dg_call(struct clnt_req *cc)
 	 * Nb, we should probably use getpagesize() on Unix.  Need
 	 * an equivalent for Windows.
 	 */
-	xioq = xdr_ioq_create(RPC_MAXDATA_DEFAULT,
-			      __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT,
-			      (cc->cc_auth->ah_cred.oa_flavor == RPCSEC_GSS)
-			      ? UIO_FLAG_REALLOC | UIO_FLAG_FREE
-			      : UIO_FLAG_FREE);
+	xioq = xdr_ioq_create_cached(
+		RPC_MAXDATA_DEFAULT,
+		__svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT,
+		(cc->cc_auth->ah_cred.oa_flavor == RPCSEC_GSS)
+		? UIO_FLAG_REALLOC | UIO_FLAG_FREE
+		: UIO_FLAG_FREE);
 
 	xdrs = xioq->xdrs;
 	cc->cc_error.re_status = RPC_SUCCESS;
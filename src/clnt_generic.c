@@ -506,7 +506,6 @@ clnt_req_reset(struct clnt_req *cc)
 					   CLNT_REQ_FLAG_EXPIRING)
 	    & CLNT_REQ_FLAG_EXPIRING) {
 		svc_rqst_expire_remove(cc);
-		cc->cc_expire_ms = 0;	/* atomic barrier(s) */
 	}
 }
 
@@ -586,7 +585,6 @@ clnt_req_process_reply(SVCXPRT *xprt, struct svc_req *req)
 					   CLNT_REQ_FLAG_EXPIRING)
 	    & CLNT_REQ_FLAG_EXPIRING) {
 		svc_rqst_expire_remove(cc);
-		cc->cc_expire_ms = 0;	/* atomic barrier(s) */
 	}
 
 	if (atomic_postset_uint16_t_bits(&cc->cc_flags, CLNT_REQ_FLAG_ACKSYNC)
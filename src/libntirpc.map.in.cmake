@@ -129,18 +129,24 @@ NTIRPC_${NTIRPC_VERSION} {
     setrpcent;
     svc_auth_authenticate;
     svc_auth_reg;
+    svc_cksum_set;
     svc_dg_ncreatef;
     svc_fd_ncreatef;
     svc_init;
     svc_ncreate;
     svc_raw_ncreate;
     svc_reg;
+    svc_reuseport_ncreate;
     svc_rqst_new_evchan;
+    svc_rqst_new_evchan_pool;
+    svc_rqst_new_evchan_shared;
     svc_rqst_evchan_reg;
     svc_rqst_evchan_unreg;
+    svc_rqst_get_stats;
     svc_rqst_shutdown;
     svc_rqst_thrd_run;
     svc_rqst_thrd_signal;
+    svc_sendq_get_stats;
     svc_sendreply;
     svc_shutdown;
     svc_tli_ncreate;
@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2019 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file rpc_cksum.c
+ * @brief Request checksums for duplicate request caches
+ *
+ * @section DESCRIPTION
+ *
+ * The arguments are hashed where they were received, following the
+ * xdr_ioq_uv segments after the decode position.  Every algorithm
+ * consumes a stream of fixed blocks, so the result does not depend on
+ * how the request happened to be segmented.
+ *
+ * The algorithm and coverage are chosen per program, defaulting to
+ * CityHash64 over the first 256 bytes.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include <rpc/types.h>
+#include <reentrant.h>
+#include <misc/portable.h>
+#include <misc/abstract_atomic.h>
+#include <misc/city.h>
+#include <rpc/rpc.h>
+#include <rpc/xdr_ioq.h>
+#include <rpc/rpc_cksum.h>
+
+#include "svc_internal.h"
+
+#define RPC_CKSUM_BLOCK 256		/* CityHash64 and XXH64 input */
+#define RPC_CKSUM_SEED 103
+#define RPC_CKSUM_SAMPLE 64		/* bytes in each sample */
+#define RPC_CKSUM_PROGS 32
+
+/*
+ * Parameters pack into the low word of a table entry, the program
+ * into the high word, so readers load either whole.
+ */
+#define RPC_CKSUM_PACK(type, cover, samples, len) \
+	((uint32_t)(type) | (uint32_t)(cover) << 4 | \
+	 (uint32_t)(samples) << 8 | (uint32_t)(len) << 16)
+#define RPC_CKSUM_TYPE(p)	((p) & 0xf)
+#define RPC_CKSUM_COVER(p)	(((p) >> 4) & 0xf)
+#define RPC_CKSUM_SAMPLES(p)	(((p) >> 8) & 0xff)
+#define RPC_CKSUM_LEN(p)	((p) >> 16)
+
+static uint32_t rpc_cksum_default =
+	RPC_CKSUM_PACK(RPC_CKSUM_CITY64, RPC_CKSUM_PREFIX, 0, 256);
+static uint64_t rpc_cksum_progs[RPC_CKSUM_PROGS];
+static mutex_t rpc_cksum_mtx = MUTEX_INITIALIZER;
+
+/* XXH64 primes */
+#define XXH_P1 0x9E3779B185EBCA87ULL
+#define XXH_P2 0xC2B2AE3D27D4EB4FULL
+#define XXH_P3 0x165667B19E3779F9ULL
+#define XXH_P4 0x85EBCA77C2B2AE63ULL
+#define XXH_P5 0x27D4EB2F165667C5ULL
+
+struct rpc_cksum_ctx {
+	uint32_t type;
+	uint32_t crc;
+	uint64_t h;			/* CityHash64 chain */
+	uint64_t v[4];			/* XXH64 lanes */
+	uint64_t total;
+	u_int fill;
+	uint8_t buf[RPC_CKSUM_BLOCK];
+};
+
+static inline uint64_t
+rpc_cksum_rotl(uint64_t x, int r)
+{
+	return ((x << r) | (x >> (64 - r)));
+}
+
+static inline uint64_t
+rpc_cksum_read64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return (le64toh(v));
+}
+
+static inline uint64_t
+xxh64_round(uint64_t acc, uint64_t input)
+{
+	acc += input * XXH_P2;
+	return (rpc_cksum_rotl(acc, 31) * XXH_P1);
+}
+
+static inline uint64_t
+xxh64_merge(uint64_t acc, uint64_t v)
+{
+	acc ^= xxh64_round(0, v);
+	return (acc * XXH_P1 + XXH_P4);
+}
+
+static void
+xxh64_stripes(struct rpc_cksum_ctx *ctx, const uint8_t *p, size_t len)
+{
+	const uint8_t *end = p + len;
+
+	for (; p < end; p += 32) {
+		ctx->v[0] = xxh64_round(ctx->v[0], rpc_cksum_read64(p));
+		ctx->v[1] = xxh64_round(ctx->v[1], rpc_cksum_read64(p + 8));
+		ctx->v[2] = xxh64_round(ctx->v[2], rpc_cksum_read64(p + 16));
+		ctx->v[3] = xxh64_round(ctx->v[3], rpc_cksum_read64(p + 24));
+	}
+}
+
+static uint64_t
+xxh64_final(struct rpc_cksum_ctx *ctx)
+{
+	const uint8_t *p = ctx->buf;
+	size_t stripes = ctx->fill & ~31;
+	size_t len = ctx->fill - stripes;
+	uint64_t h;
+
+	xxh64_stripes(ctx, p, stripes);
+	p += stripes;
+
+	if (ctx->total >= 32) {
+		h = rpc_cksum_rotl(ctx->v[0], 1) + rpc_cksum_rotl(ctx->v[1], 7)
+		  + rpc_cksum_rotl(ctx->v[2], 12)
+		  + rpc_cksum_rotl(ctx->v[3], 18);
+		h = xxh64_merge(h, ctx->v[0]);
+		h = xxh64_merge(h, ctx->v[1]);
+		h = xxh64_merge(h, ctx->v[2]);
+		h = xxh64_merge(h, ctx->v[3]);
+	} else {
+		h = RPC_CKSUM_SEED + XXH_P5;
+	}
+	h += ctx->total;
+
+	for (; len >= 8; len -= 8, p += 8) {
+		h ^= xxh64_round(0, rpc_cksum_read64(p));
+		h = rpc_cksum_rotl(h, 27) * XXH_P1 + XXH_P4;
+	}
+	if (len >= 4) {
+		uint32_t w;
+
+		memcpy(&w, p, sizeof(w));
+		h ^= (uint64_t)le32toh(w) * XXH_P1;
+		h = rpc_cksum_rotl(h, 23) * XXH_P2 + XXH_P3;
+		len -= 4;
+		p += 4;
+	}
+	for (; len; len--, p++) {
+		h ^= *p * XXH_P5;
+		h = rpc_cksum_rotl(h, 11) * XXH_P1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_P2;
+	h ^= h >> 29;
+	h *= XXH_P3;
+	h ^= h >> 32;
+	return (h);
+}
+
+static void
+rpc_cksum_init(struct rpc_cksum_ctx *ctx, uint32_t type)
+{
+	ctx->type = type;
+	ctx->crc = 0;
+	ctx->h = RPC_CKSUM_SEED;
+	ctx->v[0] = RPC_CKSUM_SEED + XXH_P1 + XXH_P2;
+	ctx->v[1] = RPC_CKSUM_SEED + XXH_P2;
+	ctx->v[2] = RPC_CKSUM_SEED;
+	ctx->v[3] = RPC_CKSUM_SEED - XXH_P1;
+	ctx->total = 0;
+	ctx->fill = 0;
+}
+
+static inline void
+rpc_cksum_block(struct rpc_cksum_ctx *ctx, const uint8_t *p)
+{
+	if (ctx->type == RPC_CKSUM_CITY64)
+		ctx->h = CityHash64WithSeed((const char *)p, RPC_CKSUM_BLOCK,
+					    ctx->h);
+	else
+		xxh64_stripes(ctx, p, RPC_CKSUM_BLOCK);
+}
+
+static void
+rpc_cksum_update(struct rpc_cksum_ctx *ctx, const uint8_t *p, size_t len)
+{
+	size_t n;
+
+	ctx->total += len;
+
+	if (ctx->type == RPC_CKSUM_CRC32C) {
+		for (; len; len -= n, p += n) {
+			n = MIN(len, UINT32_MAX);
+			ctx->crc = calculate_crc32c(ctx->crc, p, n);
+		}
+		return;
+	}
+
+	if (ctx->fill) {
+		n = MIN(len, RPC_CKSUM_BLOCK - ctx->fill);
+		memcpy(ctx->buf + ctx->fill, p, n);
+		ctx->fill += n;
+		p += n;
+		len -= n;
+		if (ctx->fill < RPC_CKSUM_BLOCK)
+			return;
+		rpc_cksum_block(ctx, ctx->buf);
+		ctx->fill = 0;
+	}
+	for (; len >= RPC_CKSUM_BLOCK; len -= RPC_CKSUM_BLOCK,
+					p += RPC_CKSUM_BLOCK)
+		rpc_cksum_block(ctx, p);
+	if (len) {
+		memcpy(ctx->buf, p, len);
+		ctx->fill = len;
+	}
+}
+
+static uint64_t
+rpc_cksum_final(struct rpc_cksum_ctx *ctx)
+{
+	switch (ctx->type) {
+	case RPC_CKSUM_CRC32C:
+		return (ctx->total << 32 | ctx->crc);
+	case RPC_CKSUM_XXH64:
+		return (xxh64_final(ctx));
+	default:
+		if (ctx->fill || !ctx->total)
+			ctx->h = CityHash64WithSeed((const char *)ctx->buf,
+						    ctx->fill, ctx->h);
+		return (ctx->h);
+	}
+}
+
+/*
+ * The received bytes from the decode position:  the rest of the
+ * current segment, then each following one.
+ */
+struct rpc_cksum_cursor {
+	const uint8_t *p;
+	size_t len;
+	size_t off;			/* of p in the stream */
+	struct xdr_ioq_uv *uv;		/* NULL when contiguous */
+};
+
+static void
+rpc_cksum_cursor_init(struct rpc_cksum_cursor *cur, struct svc_req *req,
+		      void *data, size_t length)
+{
+	XDR *xdrs = req->rq_xdrs;
+
+	cur->p = data;
+	cur->len = length;
+	cur->off = 0;
+	cur->uv = NULL;
+
+	if (xdrs && xdrs->x_ops == &xdr_ioq_ops && xdrs->x_data == data
+	    && xdrs->x_base) {
+		cur->len = xdr_tail_inline(xdrs);
+		cur->uv = IOQV(xdrs->x_base);
+	}
+}
+
+static bool
+rpc_cksum_cursor_next(struct rpc_cksum_cursor *cur)
+{
+	struct poolq_entry *have;
+
+	if (!cur->uv)
+		return (false);
+	have = TAILQ_NEXT(&cur->uv->uvq, q);
+	if (!have)
+		return (false);
+
+	cur->off += cur->len;
+	cur->uv = IOQ_(have);
+	cur->p = cur->uv->v.vio_head;
+	cur->len = ioquv_length(cur->uv);
+	return (true);
+}
+
+static size_t
+rpc_cksum_cursor_total(const struct rpc_cksum_cursor *cur)
+{
+	struct rpc_cksum_cursor walk = *cur;
+	size_t total;
+
+	do {
+		total = walk.off + walk.len;
+	} while (rpc_cksum_cursor_next(&walk));
+	return (total);
+}
+
+/*
+ * Hash [off, off + len) of the stream; calls are in increasing order.
+ */
+static void
+rpc_cksum_range(struct rpc_cksum_ctx *ctx, struct rpc_cksum_cursor *cur,
+		size_t off, size_t len)
+{
+	size_t skip;
+	size_t n;
+
+	while (len) {
+		while (off >= cur->off + cur->len) {
+			if (!rpc_cksum_cursor_next(cur))
+				return;
+		}
+		skip = off - cur->off;
+		n = MIN(len, cur->len - skip);
+		rpc_cksum_update(ctx, cur->p + skip, n);
+		off += n;
+		len -= n;
+	}
+}
+
+static inline uint32_t
+rpc_cksum_lookup(rpcprog_t prog)
+{
+	uint64_t entry;
+	int ix;
+
+	for (ix = 0; ix < RPC_CKSUM_PROGS; ix++) {
+		entry = atomic_fetch_uint64_t(&rpc_cksum_progs[ix]);
+		if (!entry)
+			break;
+		if ((entry >> 32) == prog)
+			return ((uint32_t)entry);
+	}
+	return (atomic_fetch_uint32_t(&rpc_cksum_default));
+}
+
+/*
+ * xp_checksum for the socket transports
+ */
+void
+svc_cksum(struct svc_req *req, void *data, size_t length)
+{
+	uint32_t params = rpc_cksum_lookup(req->rq_msg.cb_prog);
+	uint32_t len = RPC_CKSUM_LEN(params);
+	uint32_t samples = RPC_CKSUM_SAMPLES(params);
+	struct rpc_cksum_cursor cur;
+	struct rpc_cksum_ctx ctx;
+	size_t total, stride;
+	uint64_t total_le;
+	uint32_t ix;
+
+	rpc_cksum_cursor_init(&cur, req, data, length);
+	rpc_cksum_init(&ctx, RPC_CKSUM_TYPE(params));
+
+	switch (RPC_CKSUM_COVER(params)) {
+	case RPC_CKSUM_FULL:
+		rpc_cksum_range(&ctx, &cur, 0, SIZE_MAX);
+		break;
+	case RPC_CKSUM_SAMPLED:
+		total = rpc_cksum_cursor_total(&cur);
+		if (total <= len + samples * RPC_CKSUM_SAMPLE) {
+			rpc_cksum_range(&ctx, &cur, 0, total);
+			break;
+		}
+		rpc_cksum_range(&ctx, &cur, 0, len);
+		stride = (total - len) / samples;
+		for (ix = 0; ix < samples; ix++)
+			rpc_cksum_range(&ctx, &cur, len + ix * stride,
+					RPC_CKSUM_SAMPLE);
+		/* requests differing only in length */
+		total_le = htole64(total);
+		rpc_cksum_update(&ctx, (const uint8_t *)&total_le,
+				 sizeof(total_le));
+		break;
+	default:
+		rpc_cksum_range(&ctx, &cur, 0, len);
+		break;
+	};
+
+	req->rq_cksum = rpc_cksum_final(&ctx);
+}
+
+bool
+svc_cksum_set(rpcprog_t prog, const struct rpc_cksum_params *params)
+{
+	uint32_t packed;
+	uint64_t entry;
+	int ix;
+
+	if (params->type > RPC_CKSUM_XXH64
+	    || params->cover > RPC_CKSUM_SAMPLED
+	    || params->len > UINT16_MAX
+	    || (params->cover != RPC_CKSUM_FULL && !params->len)
+	    || (params->cover == RPC_CKSUM_SAMPLED
+		&& (!params->samples || params->samples > UINT8_MAX))) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: invalid parameters for program %u",
+			__func__, prog);
+		return (false);
+	}
+	packed = RPC_CKSUM_PACK(params->type, params->cover,
+				params->cover == RPC_CKSUM_SAMPLED
+					? params->samples : 0,
+				params->len);
+
+	if (!prog) {
+		atomic_store_uint32_t(&rpc_cksum_default, packed);
+		return (true);
+	}
+
+	mutex_lock(&rpc_cksum_mtx);
+	for (ix = 0; ix < RPC_CKSUM_PROGS; ix++) {
+		entry = rpc_cksum_progs[ix];
+		if (!entry || (entry >> 32) == prog) {
+			atomic_store_uint64_t(&rpc_cksum_progs[ix],
+					      (uint64_t)prog << 32 | packed);
+			mutex_unlock(&rpc_cksum_mtx);
+			return (true);
+		}
+	}
+	mutex_unlock(&rpc_cksum_mtx);
+
+	__warnx(TIRPC_DEBUG_FLAG_ERROR,
+		"%s: no room for program %u",
+		__func__, prog);
+	return (false);
+}
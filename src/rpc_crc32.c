@@ -46,8 +46,18 @@
 #include <sys/cdefs.h>
 
 #include <stdint.h>
+#include <string.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/param.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#elif defined(__aarch64__)
+#include <sys/auxv.h>
+#include <arm_acle.h>
+#endif
 
 const uint32_t crc32_tab[] = {
 	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
@@ -976,11 +986,134 @@ static uint32_t multitable_crc32c(uint32_t crc32c, const unsigned char *buffer,
 	return (crc32c_sb8_64_bit(crc32c, buffer, length, to_even_word));
 }
 
-uint32_t calculate_crc32c(uint32_t crc32c, const unsigned char *buffer,
-			  unsigned int length)
+static uint32_t software_crc32c(uint32_t crc32c,
+				const unsigned char *buffer,
+				unsigned int length)
 {
 	if (length < 4)
 		return (singletable_crc32c(crc32c, buffer, length));
 	else
 		return (multitable_crc32c(crc32c, buffer, length));
 }
+
+#if defined(__x86_64__)
+/*
+ * SSE4.2 crc32 has a latency of three cycles, but issues every cycle:
+ * three independent lanes keep it busy.  The lanes are joined by
+ * shifting the earlier ones over the later, a carryless multiply by
+ * x^(8 * bytes - 33) mod P that the crc32 instruction then reduces.
+ */
+struct crc32c_lane {
+	unsigned int len;	/* bytes per lane */
+	uint32_t k1;		/* x^(8 * len - 33) mod P, bit reflected */
+	uint32_t k2;		/* x^(16 * len - 33) mod P, bit reflected */
+};
+
+static const struct crc32c_lane crc32c_lanes[] = {
+	{ 256, 0xb9e02b86, 0xdd7e3b0c },
+	{ 64, 0x9e4addf8, 0x0d3b6092 },
+	{ 0, 0, 0 }
+};
+
+__attribute__ ((target("sse4.2,pclmul")))
+static inline uint64_t crc32c_clmul(uint64_t crc, uint32_t k)
+{
+	return (_mm_cvtsi128_si64(
+			_mm_clmulepi64_si128(_mm_cvtsi64_si128(crc),
+					     _mm_cvtsi32_si128(k), 0)));
+}
+
+__attribute__ ((target("sse4.2,pclmul")))
+static uint32_t sse42_crc32c(uint32_t crc32c, const unsigned char *buffer,
+			     unsigned int length)
+{
+	const struct crc32c_lane *lane;
+	const unsigned char *end;
+	uint64_t crc0, crc1, crc2;
+	uint64_t v0, v1, v2;
+
+	for (; length && ((uintptr_t) buffer & 7); length--)
+		crc32c = _mm_crc32_u8(crc32c, *buffer++);
+
+	for (lane = crc32c_lanes; lane->len; lane++) {
+		while (length >= 3 * lane->len) {
+			crc0 = crc32c;
+			crc1 = 0;
+			crc2 = 0;
+			for (end = buffer + lane->len; buffer < end;
+			     buffer += 8) {
+				memcpy(&v0, buffer, 8);
+				memcpy(&v1, buffer + lane->len, 8);
+				memcpy(&v2, buffer + 2 * lane->len, 8);
+				crc0 = _mm_crc32_u64(crc0, v0);
+				crc1 = _mm_crc32_u64(crc1, v1);
+				crc2 = _mm_crc32_u64(crc2, v2);
+			}
+			crc32c = _mm_crc32_u64(0, crc32c_clmul(crc0, lane->k2)
+						  ^ crc32c_clmul(crc1, lane->k1))
+				 ^ crc2;
+			buffer += 2 * lane->len;
+			length -= 3 * lane->len;
+		}
+	}
+
+	for (; length >= 8; length -= 8, buffer += 8) {
+		memcpy(&v0, buffer, 8);
+		crc32c = _mm_crc32_u64(crc32c, v0);
+	}
+	for (; length; length--)
+		crc32c = _mm_crc32_u8(crc32c, *buffer++);
+	return (crc32c);
+}
+#elif defined(__aarch64__) && defined(HWCAP_CRC32)
+__attribute__ ((target("arch=armv8-a+crc")))
+static uint32_t armv8_crc32c(uint32_t crc32c, const unsigned char *buffer,
+			     unsigned int length)
+{
+	uint64_t v;
+
+	for (; length && ((uintptr_t) buffer & 7); length--)
+		crc32c = __crc32cb(crc32c, *buffer++);
+	for (; length >= 8; length -= 8, buffer += 8) {
+		memcpy(&v, buffer, 8);
+		crc32c = __crc32cd(crc32c, v);
+	}
+	for (; length; length--)
+		crc32c = __crc32cb(crc32c, *buffer++);
+	return (crc32c);
+}
+#endif
+
+static uint32_t (*crc32c_impl)(uint32_t, const unsigned char *,
+			       unsigned int);
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+static void crc32c_select(void)
+{
+#if defined(__x86_64__)
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)
+	    && (ecx & bit_SSE4_2) && (ecx & bit_PCLMUL)) {
+		crc32c_impl = sse42_crc32c;
+		return;
+	}
+#elif defined(__aarch64__) && defined(HWCAP_CRC32)
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+		crc32c_impl = armv8_crc32c;
+		return;
+	}
+#endif
+	crc32c_impl = software_crc32c;
+}
+
+/*
+ * Update crc32c (Castagnoli) over buffer, without pre- or post-
+ * inversion.  The instructions are chosen once, at first use.
+ */
+uint32_t calculate_crc32c(uint32_t crc32c, const unsigned char *buffer,
+			  unsigned int length)
+{
+	pthread_once(&crc32c_once, crc32c_select);
+	return (crc32c_impl(crc32c, buffer, length));
+}
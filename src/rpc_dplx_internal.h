@@ -29,6 +29,7 @@
 
 #include <misc/queue.h>
 #include <misc/rbtree.h>
+#include <misc/timer_wheel.h>
 #include <misc/wait_queue.h>
 #include <rpc/svc.h>
 #include <rpc/xdr_ioq.h>
@@ -36,7 +37,8 @@
 /* Svc event strategy */
 enum svc_event_type {
 	SVC_EVENT_FDSET /* trad. using select and poll (currently unhooked) */ ,
-	SVC_EVENT_EPOLL		/* Linux epoll interface */
+	SVC_EVENT_EPOLL,	/* Linux epoll interface */
+	SVC_EVENT_IO_URING	/* Linux io_uring interface */
 };
 
 typedef struct rpc_dplx_lock {
@@ -53,6 +55,9 @@ struct rpc_dplx_rec {
 	struct xdr_ioq ioq;
 	struct opr_rbtree call_replies;
 	struct opr_rbtree_node fd_node;
+	uint64_t retire_epoch;		/**< unreferenced and unpublished at */
+	struct timer_wheel_entry idle_q; /**< reaped after idle_timeout */
+	bool idle_off;			/**< not (or no longer) reaped */
 	struct {
 		rpc_dplx_lock_t lock;
 		struct timespec ts;
@@ -66,6 +71,11 @@ struct rpc_dplx_rec {
 		struct {
 			struct epoll_event event;
 		} epoll;
+#endif
+#if defined(TIRPC_IO_URING)
+		struct {
+			uint64_t user_data;	/* current poll request */
+		} io_uring;
 #endif
 	} ev_u;
 	void *ev_p;			/* struct svc_rqst_rec (internal) */
@@ -76,6 +86,10 @@ struct rpc_dplx_rec {
 	u_int sendsz;
 	uint32_t call_xid;		/**< current call xid */
 	uint32_t ev_count;		/**< atomic count of waiting events */
+	uint32_t ev_events;		/**< poll events of the current task */
+	uint64_t sendq_bytes;		/**< (atomic) queued output */
+	struct poolq_entry sendq_paused; /**< paused over output budget */
+	struct svcauth_unix_cache *au_cache; /**< last AUTH_UNIX credential */
 };
 #define REC_XPRT(p) (opr_containerof((p), struct rpc_dplx_rec, xprt))
 
@@ -83,6 +97,9 @@ struct rpc_dplx_rec {
 #define RPC_DPLX_LOCKED		0x00100000
 #define RPC_DPLX_UNLOCK		0x00200000
 
+/* in svc_auth_unix.c */
+void svcauth_unix_cache_free(struct svcauth_unix_cache *);
+
 /* in clnt_generic.c */
 enum xprt_stat clnt_req_process_reply(SVCXPRT *, struct svc_req *);
 int clnt_req_xid_cmpf(const struct opr_rbtree_node *lhs,
@@ -110,6 +127,8 @@ rpc_dplx_rec_init(struct rpc_dplx_rec *rec)
 	mutex_init(&rec->xprt.xp_lock, NULL);
 	/* Stop this xprt being cleaned immediately */
 	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &(rec->recv.ts));
+	timer_wheel_entry_init(&rec->idle_q);
+	rec->idle_off = true;
 
 	rec->xprt.xp_refcnt = 1;
 	poolq_head_setup(&rec->xprt.sendq);
@@ -120,6 +139,8 @@ rpc_dplx_rec_destroy(struct rpc_dplx_rec *rec)
 {
 	rpc_dplx_lock_destroy(&rec->recv.lock);
 	mutex_destroy(&rec->xprt.xp_lock);
+	if (rec->au_cache)
+		svcauth_unix_cache_free(rec->au_cache);
 
 #if defined(HAVE_BLKIN)
 	if (rec->xprt.blkin.svc_name)
@@ -49,6 +49,11 @@
 #include <rpc/xdr_inline.h>
 #include <rpc/auth_inline.h>
 
+#include "xdr_swap.h"
+
+/* xid through credential length */
+#define RPC_CALL_HDR_UNITS 8
+
 static const struct xdr_discrim reply_dscrm[3] = {
 	{(int)MSG_ACCEPTED, (xdrproc_t) xdr_naccepted_reply},
 	{(int)MSG_DENIED, (xdrproc_t) xdr_nrejected_reply},
@@ -423,6 +428,63 @@ xdr_reply_decode(XDR *xdrs, struct rpc_msg *dmsg, int32_t *buf)
 	return (false);
 }
 
+/*
+ * decode a call message contiguous in the current buffer
+ *
+ * Consumes nothing and returns false unless the entire header through
+ * the verifier is present and valid; the per-field path then decodes
+ * (and reports) as before.
+ */
+static inline bool
+xdr_call_decode_contig(XDR *xdrs, struct rpc_msg *dmsg)
+{
+	uint32_t hdr[RPC_CALL_HDR_UNITS];
+	uint32_t verf[2];
+	uint8_t *p = xdrs->x_data;
+	size_t avail = xdr_tail_inline(xdrs);
+	size_t verf_off;
+	size_t size;
+
+	if (avail < (RPC_CALL_HDR_UNITS + 2) * BYTES_PER_XDR_UNIT)
+		return (false);
+
+	xdr_units_ntoh(hdr, p, RPC_CALL_HDR_UNITS);
+	if (hdr[1] != CALL || hdr[2] != RPC_MSG_VERSION
+	    || hdr[7] > MAX_AUTH_BYTES)
+		return (false);
+
+	verf_off = RPC_CALL_HDR_UNITS * BYTES_PER_XDR_UNIT + RNDUP(hdr[7]);
+	if (avail < verf_off + 2 * BYTES_PER_XDR_UNIT)
+		return (false);
+
+	memcpy(verf, p + verf_off, sizeof(verf));
+	verf[1] = ntohl(verf[1]);
+	if (verf[1] > MAX_AUTH_BYTES)
+		return (false);
+
+	size = verf_off + 2 * BYTES_PER_XDR_UNIT + RNDUP(verf[1]);
+	if (avail < size)
+		return (false);
+
+	dmsg->rm_xid = hdr[0];
+	dmsg->rm_direction = CALL;
+	dmsg->rm_call.cb_rpcvers = RPC_MSG_VERSION;
+	dmsg->cb_prog = hdr[3];
+	dmsg->cb_vers = hdr[4];
+	dmsg->cb_proc = hdr[5];
+	dmsg->cb_cred.oa_flavor = hdr[6];
+	dmsg->cb_cred.oa_length = hdr[7];
+	memcpy(dmsg->cb_cred.oa_body,
+	       p + RPC_CALL_HDR_UNITS * BYTES_PER_XDR_UNIT, hdr[7]);
+	dmsg->cb_verf.oa_flavor = ntohl(verf[0]);
+	dmsg->cb_verf.oa_length = verf[1];
+	memcpy(dmsg->cb_verf.oa_body,
+	       p + verf_off + 2 * BYTES_PER_XDR_UNIT, verf[1]);
+
+	xdrs->x_data = p + size;
+	return (true);
+}
+
 /*
  * decode a duplex message, log error messages
  */
@@ -431,6 +493,13 @@ xdr_dplx_decode(XDR *xdrs, struct rpc_msg *dmsg)
 {
 	int32_t *buf;
 
+	if (xdr_call_decode_contig(xdrs, dmsg)) {
+		__warnx(TIRPC_DEBUG_FLAG_RPC_MSG,
+			"%s:%u CALL CONTIGUOUS",
+			__func__, __LINE__);
+		return (true);
+	}
+
 	/*
 	 * NOTE: 5 here, 3 more in each _decode
 	 */
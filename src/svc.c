@@ -70,6 +70,7 @@
 #include "clnt_internal.h"
 #include "svc_internal.h"
 #include "svc_xprt.h"
+#include "svc_epoch.h"
 #include "rpc_dplx_internal.h"
 #include <rpc/svc_rqst.h>
 #ifdef USE_RPC_RDMA
@@ -106,18 +107,38 @@ struct svc_params __svc_params[1] = {
  *
  * The service record is factored out to permit exporting the find
  * routines without exposing the db implementation.
+ *
+ * Registration copies the callouts into a new (immutable) table, and
+ * publishes it.  Lookups read the current table within an epoch section
+ * without svc_lock:  callouts sorted by (prog, vers, registration),
+ * hashed by (prog, vers), and netids numbered once per table.  Callouts
+ * are shared between tables, and never changed once published.  Replaced
+ * tables (and unregistered callouts) are freed after the epoch passes.
  */
-static struct svc_callout {
-	struct svc_callout *sc_next;
+struct svc_callout {
 	struct svc_record rec;
-} *svc_head;
+	struct svc_callout *sc_dead;	/* unregistered */
+};
+
+struct svc_callouts {
+	struct work_pool_entry sct_wpe;	/* deferred free */
+	struct svc_callout *sct_dead;	/* unregistered, freed with table */
+	uint32_t sct_count;
+	uint32_t sct_mask;		/* sct_index size - 1 */
+	uint32_t sct_nnetids;
+	char **sct_netids;		/* [1..sct_nnetids] */
+	uint32_t *sct_index;		/* first of (prog, vers) + 1, or 0 */
+	uint32_t *sct_netid_ix;		/* per callout, 0 for any netid */
+	struct svc_callout *sct_callouts[];
+};
+
+#define SVC_CALLOUTS_INDEX_MIN 8
+
+static struct svc_callouts *svc_callouts;
 
 extern rwlock_t svc_lock;
 extern rwlock_t svc_fd_lock;
 
-static struct svc_callout *svc_find(rpcprog_t, rpcvers_t, struct svc_callout **,
-				    char *);
-
 struct work_pool svc_work_pool;
 
 /* Package init function.
@@ -161,6 +182,13 @@ svc_init(svc_init_params *params)
 		__svc_params->ev_type = SVC_EVENT_EPOLL;
 		__svc_params->ev_u.evchan.max_events = params->max_events;
 	}
+#if defined(TIRPC_IO_URING)
+	if (params->flags & SVC_INIT_IO_URING) {
+		/* falls back to epoll per channel, when unavailable */
+		__svc_params->ev_type = SVC_EVENT_IO_URING;
+		__svc_params->ev_u.evchan.max_events = params->max_events;
+	}
+#endif
 #else
 	/* XXX formerly select/fd_set case, now placeholder for new
 	 * event systems, reworked select, etc. */
@@ -171,11 +199,49 @@ svc_init(svc_init_params *params)
 	if (params->flags & SVC_INIT_NOREG_XPRTS)
 		__svc_params->flags |= SVC_FLAG_NOREG_XPRTS;
 
+	/* drain stream sockets until EAGAIN on each event */
+	if (params->flags & SVC_INIT_VC_DRAIN)
+		__svc_params->flags |= SVC_FLAG_VC_DRAIN;
+
+	/* MSG_ZEROCOPY for large stream replies, where supported */
+	if (params->flags & SVC_INIT_ZEROCOPY)
+		__svc_params->flags |= SVC_FLAG_ZEROCOPY;
+
+	/* stream output never blocks a worker, resumed on POLLOUT */
+	if (params->flags & SVC_INIT_NONBLOCK_OUT)
+		__svc_params->flags |= SVC_FLAG_NONBLOCK_OUT;
+
+	/* recvmmsg()/sendmmsg() on datagram transports */
+	if (params->flags & SVC_INIT_DG_BATCH) {
+		__svc_params->flags |= SVC_FLAG_DG_BATCH;
+		__svc_params->dg_batch = params->dg_batch
+			? MIN(params->dg_batch, SVC_DG_BATCH_MAX)
+			: SVC_DG_BATCH_DEFAULT;
+	}
+
+	/* epoll channels spin briefly after events before sleeping */
+	if (params->flags & SVC_INIT_BUSY_POLL) {
+		__svc_params->flags |= SVC_FLAG_BUSY_POLL;
+		__svc_params->busy_poll_us = params->busy_poll_us
+			? MIN(params->busy_poll_us, SVC_BUSY_POLL_MAX)
+			: SVC_BUSY_POLL_DEFAULT;
+	}
+
 	if (params->ioq_send_max)
 		__svc_params->ioq.send_max = params->ioq_send_max;
 	else
 		__svc_params->ioq.send_max = RPC_MAXDATA_DEFAULT;
 
+	/* older callers' params end before the budgets */
+	__svc_params->ioq.sendq_budget = SVC_SENDQ_BUDGET_DEFAULT;
+	__svc_params->ioq.sendq_global = 0;
+	if (params->flags & SVC_INIT_SENDQ_BUDGET) {
+		if (params->ioq_sendq_budget)
+			__svc_params->ioq.sendq_budget =
+				params->ioq_sendq_budget;
+		__svc_params->ioq.sendq_global = params->ioq_sendq_global;
+	}
+
 	__svc_params->ioq.thrd_min = SVC_WORK_POOL_THRD_MIN;
 	if (__svc_params->ioq.thrd_min < params->ioq_thrd_min)
 		__svc_params->ioq.thrd_min = params->ioq_thrd_min;
@@ -194,6 +260,15 @@ svc_init(svc_init_params *params)
 	if (work_pool_params.thrd_max < work_pool_params.thrd_min)
 		work_pool_params.thrd_max = work_pool_params.thrd_min;
 
+	/* workers bound to CPUs or nodes, channels placed among them */
+	work_pool_params.flags = WORK_POOL_FLAG_NONE;
+	if (params->flags & SVC_INIT_CPU_AFFINITY)
+		work_pool_params.flags |= WORK_POOL_FLAG_CPU;
+	else if (params->flags & SVC_INIT_NUMA_AFFINITY)
+		work_pool_params.flags |= WORK_POOL_FLAG_NUMA;
+	if (work_pool_params.flags)
+		__svc_params->flags |= SVC_FLAG_AFFINITY;
+
 	if (work_pool_init(&svc_work_pool, "svc_", &work_pool_params)) {
 		mutex_unlock(&__svc_params->mtx);
 		return false;
@@ -307,6 +382,202 @@ __rpc_address_set_length(struct rpc_address *rpca, socklen_t sl)
 	}
 }
 
+/* ********************** CALLOUT list related stuff ************* */
+
+static inline uint32_t
+svc_callouts_hash(rpcprog_t prog, rpcvers_t vers)
+{
+	uint64_t k = ((uint64_t)prog << 32) | (uint32_t)vers;
+
+	k *= 0x9e3779b97f4a7c15ULL;
+	return ((uint32_t)(k >> 32));
+}
+
+/* number for netid in this table, or 0 when absent */
+static inline uint32_t
+svc_callouts_netid(const struct svc_callouts *sct, const char *netid)
+{
+	uint32_t ix;
+
+	if (!netid)
+		return (0);
+	for (ix = 1; ix <= sct->sct_nnetids; ix++) {
+		if (sct->sct_netids[ix] == netid
+		 || !strcmp(sct->sct_netids[ix], netid))
+			return (ix);
+	}
+	return (0);
+}
+
+/* first callout index for (prog, vers), or -1 */
+static inline int
+svc_callouts_first(const struct svc_callouts *sct, rpcprog_t prog,
+		   rpcvers_t vers)
+{
+	const struct svc_callout *s;
+	uint32_t ix;
+	uint32_t n;
+
+	if (!sct)
+		return (-1);
+	ix = svc_callouts_hash(prog, vers) & sct->sct_mask;
+	while ((n = sct->sct_index[ix])) {
+		s = sct->sct_callouts[n - 1];
+		if (s->rec.sc_prog == prog && s->rec.sc_vers == vers)
+			return (n - 1);
+		ix = (ix + 1) & sct->sct_mask;
+	}
+	return (-1);
+}
+
+static int
+svc_callout_cmpf(const void *lhs, const void *rhs)
+{
+	const struct svc_callout *l = *(const struct svc_callout **)lhs;
+	const struct svc_callout *r = *(const struct svc_callout **)rhs;
+
+	if (l->rec.sc_prog != r->rec.sc_prog)
+		return (l->rec.sc_prog < r->rec.sc_prog) ? -1 : 1;
+	if (l->rec.sc_vers != r->rec.sc_vers)
+		return (l->rec.sc_vers < r->rec.sc_vers) ? -1 : 1;
+	return (0);
+}
+
+/*
+ * svc_lock held for write.  Copies the current callouts, without those
+ * matching (prog, vers) when unreg, and with add (if any) registered
+ * last.  qsort is not stable, so the copy is insertion sorted.
+ */
+static struct svc_callouts *
+svc_callouts_copy(struct svc_callout *add, rpcprog_t prog, rpcvers_t vers,
+		  bool unreg)
+{
+	struct svc_callouts *cur = svc_callouts;
+	struct svc_callouts *sct;
+	struct svc_callout *s;
+	uint32_t count = 0;
+	uint32_t size = SVC_CALLOUTS_INDEX_MIN;
+	uint32_t ix;
+	uint32_t jx;
+
+	if (cur)
+		count = cur->sct_count;
+	if (add)
+		count++;
+	while (size < 2 * count)
+		size <<= 1;
+
+	sct = mem_zalloc(sizeof(*sct) + count * sizeof(struct svc_callout *));
+	sct->sct_index = mem_zalloc(size * sizeof(uint32_t));
+	sct->sct_mask = size - 1;
+	sct->sct_netids = mem_zalloc((count + 1) * sizeof(char *));
+	sct->sct_netid_ix = mem_zalloc((count + 1) * sizeof(uint32_t));
+
+	for (ix = 0; cur && ix < cur->sct_count; ix++) {
+		s = cur->sct_callouts[ix];
+		if (unreg && s->rec.sc_prog == prog && s->rec.sc_vers == vers) {
+			/* freed with cur, after lookups have left it */
+			s->sc_dead = cur->sct_dead;
+			cur->sct_dead = s;
+			continue;
+		}
+		sct->sct_callouts[sct->sct_count++] = s;
+	}
+	if (add)
+		sct->sct_callouts[sct->sct_count++] = add;
+
+	/* insertion sort is stable, and short */
+	for (ix = 1; ix < sct->sct_count; ix++) {
+		s = sct->sct_callouts[ix];
+		for (jx = ix; jx > 0
+		     && svc_callout_cmpf(&sct->sct_callouts[jx - 1], &s) > 0;
+		     jx--)
+			sct->sct_callouts[jx] = sct->sct_callouts[jx - 1];
+		sct->sct_callouts[jx] = s;
+	}
+
+	for (ix = 0; ix < sct->sct_count; ix++) {
+		s = sct->sct_callouts[ix];
+
+		sct->sct_netid_ix[ix] = svc_callouts_netid(sct,
+							   s->rec.sc_netid);
+		if (s->rec.sc_netid && !sct->sct_netid_ix[ix]) {
+			sct->sct_netids[++(sct->sct_nnetids)] = s->rec.sc_netid;
+			sct->sct_netid_ix[ix] = sct->sct_nnetids;
+		}
+
+		if (ix && !svc_callout_cmpf(&sct->sct_callouts[ix - 1], &s))
+			continue;
+
+		jx = svc_callouts_hash(s->rec.sc_prog, s->rec.sc_vers)
+			& sct->sct_mask;
+		while (sct->sct_index[jx])
+			jx = (jx + 1) & sct->sct_mask;
+		sct->sct_index[jx] = ix + 1;
+	}
+	return (sct);
+}
+
+static void
+svc_callouts_free(struct work_pool_entry *wpe)
+{
+	struct svc_callouts *sct =
+		opr_containerof(wpe, struct svc_callouts, sct_wpe);
+	struct svc_callout *s;
+
+	while ((s = sct->sct_dead)) {
+		sct->sct_dead = s->sc_dead;
+		if (s->rec.sc_netid)
+			mem_free(s->rec.sc_netid, strlen(s->rec.sc_netid) + 1);
+		mem_free(s, sizeof(struct svc_callout));
+	}
+	mem_free(sct->sct_netids, (sct->sct_count + 1) * sizeof(char *));
+	mem_free(sct->sct_netid_ix, (sct->sct_count + 1) * sizeof(uint32_t));
+	mem_free(sct->sct_index, (sct->sct_mask + 1) * sizeof(uint32_t));
+	mem_free(sct, sizeof(*sct)
+		 + sct->sct_count * sizeof(struct svc_callout *));
+}
+
+/*
+ * svc_lock held for write.  Publishes sct, and frees the current table
+ * once lookups have left it.
+ */
+static void
+svc_callouts_publish(struct svc_callouts *sct)
+{
+	struct svc_callouts *cur = svc_callouts;
+
+	atomic_store_voidptr((void **)&svc_callouts, sct);
+	if (!cur)
+		return;
+
+	cur->sct_wpe.fun = svc_callouts_free;
+	if (svc_epoch_defer(&cur->sct_wpe))
+		svc_xprt_reaper_wake();
+}
+
+/*
+ * Search the callout table for a program number, return the callout
+ * struct.  svc_lock held.
+ */
+static struct svc_callout *
+svc_find(rpcprog_t prog, rpcvers_t vers, char *netid)
+{
+	struct svc_callouts *sct = svc_callouts;
+	struct svc_callout *s;
+	int ix = svc_callouts_first(sct, prog, vers);
+
+	for (; ix >= 0 && (uint32_t)ix < sct->sct_count; ix++) {
+		s = sct->sct_callouts[ix];
+		if (s->rec.sc_prog != prog || s->rec.sc_vers != vers)
+			break;
+		if ((netid == NULL) || (s->rec.sc_netid == NULL)
+		    || (strcmp(netid, s->rec.sc_netid) == 0))
+			return (s);
+	}
+	return (NULL);
+}
+
 /*
  * Add a service program to the callout list.
  * The dispatch routine will be called when a rpc request for this
@@ -318,13 +589,12 @@ svc_reg(SVCXPRT *xprt, const rpcprog_t prog, const rpcvers_t vers,
 	const struct netconfig *nconf)
 {
 	bool dummy;
-	struct svc_callout *prev;
 	struct svc_callout *s;
 	struct netconfig *tnconf;
 	char *netid = NULL;
 	int flag = 0;
 
-	/* VARIABLES PROTECTED BY svc_lock: s, prev, svc_head */
+	/* VARIABLES PROTECTED BY svc_lock: s, svc_callouts */
 	if (xprt->xp_netid) {
 		netid = mem_strdup(xprt->xp_netid);
 		flag = 1;
@@ -343,7 +613,7 @@ svc_reg(SVCXPRT *xprt, const rpcprog_t prog, const rpcvers_t vers,
 		return (false);
 
 	rwlock_wrlock(&svc_lock);
-	s = svc_find(prog, vers, &prev, netid);
+	s = svc_find(prog, vers, netid);
 	if (s) {
 		if (netid)
 			mem_free(netid, 0);
@@ -352,13 +622,12 @@ svc_reg(SVCXPRT *xprt, const rpcprog_t prog, const rpcvers_t vers,
 		rwlock_unlock(&svc_lock);
 		return (false);
 	}
-	s = mem_alloc(sizeof(struct svc_callout));
+	s = mem_zalloc(sizeof(struct svc_callout));
 	s->rec.sc_prog = prog;
 	s->rec.sc_vers = vers;
 	s->rec.sc_dispatch = dispatch;
 	s->rec.sc_netid = netid;
-	s->sc_next = svc_head;
-	svc_head = s;
+	svc_callouts_publish(svc_callouts_copy(s, prog, vers, false));
 
 	if ((xprt->xp_netid == NULL) && (flag == 1) && netid)
 		((SVCXPRT *) xprt)->xp_netid = mem_strdup(netid);
@@ -382,109 +651,69 @@ svc_reg(SVCXPRT *xprt, const rpcprog_t prog, const rpcvers_t vers,
 void
 svc_unreg(const rpcprog_t prog, const rpcvers_t vers)
 {
-	struct svc_callout *prev;
-	struct svc_callout *s;
-
 	/* unregister the information anyway */
 	(void)rpcb_unset(prog, vers, NULL);
 	rwlock_wrlock(&svc_lock);
-	while ((s = svc_find(prog, vers, &prev, NULL)) != NULL) {
-		if (prev == NULL)
-			svc_head = s->sc_next;
-		else
-			prev->sc_next = s->sc_next;
-		s->sc_next = NULL;
-		if (s->rec.sc_netid)
-			mem_free(s->rec.sc_netid, sizeof(s->rec.sc_netid) + 1);
-		mem_free(s, sizeof(struct svc_callout));
-	}
+	if (svc_find(prog, vers, NULL))
+		svc_callouts_publish(svc_callouts_copy(NULL, prog, vers,
+						       true));
 	rwlock_unlock(&svc_lock);
 }
 
-/* ********************** CALLOUT list related stuff ************* */
-
-/*
- * Search the callout list for a program number, return the callout
- * struct.
- */
-static struct svc_callout *
-svc_find(rpcprog_t prog, rpcvers_t vers,
-	 struct svc_callout **prev, char *netid)
-{
-	struct svc_callout *s, *p;
-
-	assert(prev != NULL);
-
-	p = NULL;
-	for (s = svc_head; s != NULL; s = s->sc_next) {
-		if (((s->rec.sc_prog == prog) && (s->rec.sc_vers == vers))
-		    && ((netid == NULL) || (s->rec.sc_netid == NULL)
-			|| (strcmp(netid, s->rec.sc_netid) == 0)))
-			break;
-		p = s;
-	}
-	*prev = p;
-	return (s);
-}
-
-/* An exported search routing similar to svc_find, but with error reporting
+/* An exported search routing similar to svc_find, but with error reporting.
+ * Without locks, the record remains valid until svc_unreg().
  */
 svc_lookup_result_t
 svc_lookup(svc_rec_t **rec, svc_vers_range_t *vrange,
 	   rpcprog_t prog, rpcvers_t vers, char *netid,
 	   u_int flags)
 {
-	struct svc_callout *s, *p;
+	struct svc_callouts *sct;
+	struct svc_callout *s;
 	svc_lookup_result_t code = SVC_LKP_ERR;
-	bool prog_found, vers_found, netid_found;
+	uint32_t netid_ix;
+	uint32_t ix;
+	int first;
 
-	p = NULL;
-	prog_found = vers_found = netid_found = false;
 	vrange->lowvers = vrange->highvers = 0;
 
-	for (s = svc_head; s != NULL; s = s->sc_next) {
-		if (s->rec.sc_prog == prog) {
-			prog_found = true;
-			/* track supported versions for SVC_LKP_VERS_NOTFOUND */
-			if (s->rec.sc_vers > vrange->highvers)
-				vrange->highvers = s->rec.sc_vers;
-			if (vrange->lowvers < s->rec.sc_vers)
-				vrange->lowvers = s->rec.sc_vers;
-			/* vers match */
-			if (s->rec.sc_vers == vers) {
-				vers_found = true;
-				/* the following semantics are unchanged */
-				if ((netid == NULL) || (s->rec.sc_netid == NULL)
-				    || (strcmp(netid, s->rec.sc_netid) == 0)) {
-					netid_found = true;
-					p = s;
-				}	/* netid */
-			}	/* vers */
-		}		/* prog */
-	}			/* for */
-
-	if (p != NULL) {
-		*rec = &(p->rec);
-		code = SVC_LKP_SUCCESS;
-		goto out;
-	}
-
-	if (!prog_found) {
-		code = SVC_LKP_PROG_NOTFOUND;
-		goto out;
-	}
-
-	if (!vers_found) {
-		code = SVC_LKP_VERS_NOTFOUND;
-		goto out;
+	svc_epoch_enter();
+	sct = atomic_fetch_voidptr((void **)&svc_callouts);
+	first = svc_callouts_first(sct, prog, vers);
+	if (likely(first >= 0)) {
+		netid_ix = svc_callouts_netid(sct, netid);
+		for (ix = first; ix < sct->sct_count; ix++) {
+			s = sct->sct_callouts[ix];
+			if (s->rec.sc_prog != prog || s->rec.sc_vers != vers)
+				break;
+			/* the following semantics are unchanged */
+			if ((netid == NULL) || !sct->sct_netid_ix[ix]
+			    || (netid_ix && sct->sct_netid_ix[ix] == netid_ix)) {
+				*rec = &(s->rec);
+				code = SVC_LKP_SUCCESS;
+				goto out;
+			}
+		}
+		code = SVC_LKP_NETID_NOTFOUND;
 	}
 
-	if ((netid != NULL) && (!netid_found)) {
-		code = SVC_LKP_NETID_NOTFOUND;
-		goto out;
+	/* errors only:  track supported versions of prog */
+	for (ix = 0; sct && ix < sct->sct_count; ix++) {
+		s = sct->sct_callouts[ix];
+		if (s->rec.sc_prog != prog)
+			continue;
+		if (code == SVC_LKP_ERR)
+			code = SVC_LKP_VERS_NOTFOUND;
+		if (s->rec.sc_vers > vrange->highvers)
+			vrange->highvers = s->rec.sc_vers;
+		if (vrange->lowvers < s->rec.sc_vers)
+			vrange->lowvers = s->rec.sc_vers;
 	}
+	if (code == SVC_LKP_ERR)
+		code = SVC_LKP_PROG_NOTFOUND;
 
  out:
+	svc_epoch_exit();
 	return (code);
 }
 
@@ -46,92 +46,163 @@
 #include <rpc/svc.h>
 #include <rpc/svc_auth.h>
 
+#include "rpc_dplx_internal.h"
+#include "xdr_swap.h"
+
 extern SVCAUTH svc_auth_none;
 
+/*
+ * five is the smallest unix credentials structure -
+ * timestamp, hostname len (0), uid, gid, and gids len (0).
+ */
+#define AUTH_UNIX_MIN_UNITS 5
+
+/* the "cooked" credentials, in rq_cred_body */
+struct svcauth_unix_area {
+	struct authunix_parms area_aup;
+	char area_machname[MAX_MACHINE_NAME + 1];
+	gid_t area_gids[NGRPS];
+};
+
+/*
+ * The last credential parsed on a transport.  Clients repeat theirs,
+ * so a raw body that matches skips the parse.
+ */
+struct svcauth_unix_cache {
+	u_int auc_len;
+	char auc_body[MAX_AUTH_BYTES];
+	struct svcauth_unix_area auc_area;
+};
+
+void
+svcauth_unix_cache_free(struct svcauth_unix_cache *auc)
+{
+	mem_free(auc, sizeof(*auc));
+}
+
+static inline void
+svcauth_unix_area_copy(struct svcauth_unix_area *dst,
+		       const struct svcauth_unix_area *src)
+{
+	*dst = *src;
+	dst->area_aup.aup_machname = dst->area_machname;
+	dst->area_aup.aup_gids = dst->area_gids;
+}
+
+/*
+ * Parse in place, every length checked before use.
+ */
+static enum auth_stat
+svcauth_unix_parse(struct svcauth_unix_area *area, const char *body,
+		   u_int auth_len)
+{
+	struct authunix_parms *aup = &area->area_aup;
+	uint32_t word[3];
+	size_t str_len = 0;
+	size_t gid_len = 0;
+	size_t off;
+	u_int i;
+
+	aup->aup_machname = area->area_machname;
+	aup->aup_gids = area->area_gids;
+
+	if (auth_len < AUTH_UNIX_MIN_UNITS * BYTES_PER_XDR_UNIT)
+		goto bad_len;
+
+	xdr_units_ntoh(word, body, 2);
+	aup->aup_time = (int32_t)word[0];
+	str_len = word[1];
+	if (str_len > MAX_MACHINE_NAME)
+		return (AUTH_BADCRED);
+
+	off = 2 * BYTES_PER_XDR_UNIT + RNDUP(str_len);
+	if (off + 3 * BYTES_PER_XDR_UNIT > auth_len)
+		goto bad_len;
+
+	xdr_units_ntoh(word, body + off, 3);
+	aup->aup_uid = word[0];
+	aup->aup_gid = word[1];
+	gid_len = word[2];
+	if (gid_len > NGRPS || aup->aup_uid == (uid_t)-1 ||
+			aup->aup_gid == (gid_t)-1)
+		return (AUTH_BADCRED);
+
+	off += 3 * BYTES_PER_XDR_UNIT;
+	if (off + gid_len * BYTES_PER_XDR_UNIT > auth_len)
+		goto bad_len;
+
+	memcpy(aup->aup_machname, body + 2 * BYTES_PER_XDR_UNIT, str_len);
+	aup->aup_machname[str_len] = 0;
+
+	xdr_units_ntoh((uint32_t *)aup->aup_gids, body + off, gid_len);
+	for (i = 0; i < gid_len; i++) {
+		if (aup->aup_gids[i] == (gid_t)-1)
+			return (AUTH_BADCRED);
+	}
+	aup->aup_len = gid_len;
+	return (AUTH_OK);
+
+ bad_len:
+	__warnx(TIRPC_DEBUG_FLAG_AUTH,
+		"bad auth_len gid %ld str %ld auth %u\n",
+		(long)gid_len, (long)str_len, auth_len);
+	return (AUTH_BADCRED);
+}
+
 /*
  * Unix longhand authenticator
  */
 enum auth_stat
 _svcauth_unix(struct svc_req *req)
 {
+	struct svcauth_unix_area *area;
+	struct svcauth_unix_cache *auc;
+	struct rpc_dplx_rec *rec = NULL;
+	const char *body;
 	enum auth_stat stat;
-	XDR xdrs;
-	struct authunix_parms *aup;
-	int32_t *buf;
-	struct area {
-		struct authunix_parms area_aup;
-		char area_machname[MAX_MACHINE_NAME + 1];
-		gid_t area_gids[NGRPS];
-	} *area;
 	u_int auth_len;
-	size_t str_len, gid_len;
-	u_int i;
 
 	assert(req != NULL);
 
 	req->rq_auth = &svc_auth_none;
 
-	area = (struct area *)req->rq_msg.rq_cred_body;
-	aup = &area->area_aup;
-	aup->aup_machname = area->area_machname;
-	aup->aup_gids = area->area_gids;
+	area = (struct svcauth_unix_area *)req->rq_msg.rq_cred_body;
+	body = req->rq_msg.cb_cred.oa_body;
 	auth_len = (u_int) req->rq_msg.cb_cred.oa_length;
-	xdrmem_create(&xdrs, req->rq_msg.cb_cred.oa_body, auth_len,
-		      XDR_DECODE);
-	buf = xdr_inline_decode(&xdrs, auth_len);
-	if (buf != NULL) {
-		aup->aup_time = IXDR_GET_INT32(buf);
-		str_len = (size_t) IXDR_GET_U_INT32(buf);
-		if (str_len > MAX_MACHINE_NAME) {
-			stat = AUTH_BADCRED;
-			goto done;
-		}
-		memmove(aup->aup_machname, buf, str_len);
-		aup->aup_machname[str_len] = 0;
-		str_len = RNDUP(str_len);
-		buf += str_len / sizeof(int32_t);
-		aup->aup_uid = (int)IXDR_GET_INT32(buf);
-		aup->aup_gid = (int)IXDR_GET_INT32(buf);
-		gid_len = (size_t) IXDR_GET_U_INT32(buf);
-		if (gid_len > NGRPS || aup->aup_uid == (uid_t)-1 ||
-				aup->aup_gid == (gid_t)-1) {
-			stat = AUTH_BADCRED;
-			goto done;
-		}
-		aup->aup_len = gid_len;
-		for (i = 0; i < gid_len; i++) {
-			/* suppress block warning */
-			aup->aup_gids[i] = (int)IXDR_GET_INT32(buf);
-			if (aup->aup_gids[i] == (gid_t)-1) {
-				stat = AUTH_BADCRED;
-				goto done;
-			}
+
+	/* concurrent requests on the transport just parse */
+	if (req->rq_xprt && !mutex_trylock(&req->rq_xprt->xp_lock))
+		rec = REC_XPRT(req->rq_xprt);
+
+	if (rec) {
+		auc = rec->au_cache;
+		if (auc && auc->auc_len == auth_len
+		    && !memcmp(auc->auc_body, body, auth_len)) {
+			svcauth_unix_area_copy(area, &auc->auc_area);
+			mutex_unlock(&rec->xprt.xp_lock);
+			goto ok;
 		}
-		/*
-		 * five is the smallest unix credentials structure -
-		 * timestamp, hostname len (0), uid, gid, and gids len (0).
-		 */
-		if ((5 + gid_len) * BYTES_PER_XDR_UNIT + str_len > auth_len) {
-			__warnx(TIRPC_DEBUG_FLAG_AUTH,
-				"bad auth_len gid %ld str %ld auth %u\n",
-				(long)gid_len, (long)str_len, auth_len);
-			stat = AUTH_BADCRED;
-			goto done;
+	}
+
+	stat = svcauth_unix_parse(area, body, auth_len);
+
+	if (rec) {
+		if (stat == AUTH_OK) {
+			if (!auc)
+				auc = rec->au_cache = mem_alloc(sizeof(*auc));
+			auc->auc_len = auth_len;
+			memcpy(auc->auc_body, body, auth_len);
+			auc->auc_area = *area;
 		}
-	} else if (!xdr_authunix_parms(&xdrs, aup)) {
-		xdrs.x_op = XDR_FREE;
-		(void)xdr_authunix_parms(&xdrs, aup);
-		stat = AUTH_BADCRED;
-		goto done;
+		mutex_unlock(&rec->xprt.xp_lock);
 	}
+	if (stat != AUTH_OK)
+		return (stat);
 
+ ok:
 	/* get the verifier */
 	req->rq_msg.RPCM_ack.ar_verf = req->rq_msg.cb_verf;
-	stat = AUTH_OK;
- done:
-	XDR_DESTROY(&xdrs);
-
-	return (stat);
+	return (AUTH_OK);
 }
 
 /*
@@ -53,13 +53,12 @@
 #include <string.h>
 #include <netconfig.h>
 #include <err.h>
+#include <reentrant.h>
 
 #include "rpc_com.h"
 #include "svc_internal.h"
 #include "svc_xprt.h"
 #include <rpc/svc_rqst.h>
-#include <misc/city.h>
-#include <rpc/rpc_cksum.h>
 
 #ifndef MAX
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
@@ -102,6 +101,238 @@ svc_dg_xprt_zalloc(size_t iosz)
 	return (su);
 }
 
+/*
+ * Datagram context pool
+ *
+ * Contexts for received datagrams keep their locks, conditions and
+ * buffer.  Every thread keeps a batch without locking, bounded by
+ * SVC_DG_POOL_CACHE_BYTES of buffers.  Contexts are taken on channel
+ * threads but returned on workers, so batches move whole:  a full cache
+ * goes to the shared queue (bounded by SVC_DG_POOL_BYTES, then back to
+ * the allocator), and an empty cache refills with a batch from it.  A
+ * context for another maxrec is freed when taken.
+ */
+#define SVC_DG_POOL_CACHE 16		/* per thread */
+#define SVC_DG_POOL_CACHE_BYTES (256 * 1024)	/* per thread */
+#define SVC_DG_POOL_BYTES (16 * 1024 * 1024)	/* shared */
+
+struct svc_dg_cache {
+	TAILQ_HEAD(, poolq_entry) qh;
+	size_t bytes;
+	int qcount;
+};
+
+#define SU_(p) (opr_containerof((p), struct svc_dg_xprt, su_dr.ioq.ioq_s))
+
+static struct poolq_head svc_dg_pool;
+static size_t svc_dg_pool_bytes;	/* under svc_dg_pool.qmutex */
+static pthread_once_t svc_dg_pool_once = PTHREAD_ONCE_INIT;
+static thread_key_t svc_dg_cache_key;
+static __thread struct svc_dg_cache *svc_dg_cache_self;
+
+/*
+ * Moves the whole cache to the shared queue, or frees it when the
+ * shared queue is full.
+ */
+static void
+svc_dg_cache_flush(struct svc_dg_cache *cache)
+{
+	struct poolq_entry *have;
+
+	pthread_mutex_lock(&svc_dg_pool.qmutex);
+	if (svc_dg_pool_bytes + cache->bytes <= SVC_DG_POOL_BYTES) {
+		TAILQ_CONCAT(&svc_dg_pool.qh, &cache->qh, q);
+		svc_dg_pool.qcount += cache->qcount;
+		svc_dg_pool_bytes += cache->bytes;
+		pthread_mutex_unlock(&svc_dg_pool.qmutex);
+	} else {
+		pthread_mutex_unlock(&svc_dg_pool.qmutex);
+
+		while ((have = TAILQ_FIRST(&cache->qh))) {
+			TAILQ_REMOVE(&cache->qh, have, q);
+			svc_dg_xprt_free(SU_(have));
+		}
+	}
+	cache->bytes = 0;
+	cache->qcount = 0;
+}
+
+/*
+ * Refills an empty cache with a batch from the shared queue.
+ */
+static void
+svc_dg_cache_fill(struct svc_dg_cache *cache)
+{
+	struct poolq_entry *have;
+	size_t maxrec;
+
+	pthread_mutex_lock(&svc_dg_pool.qmutex);
+	while (cache->qcount < SVC_DG_POOL_CACHE
+	       && (have = TAILQ_FIRST(&svc_dg_pool.qh))) {
+		maxrec = SU_(have)->su_dr.maxrec;
+		if (cache->qcount
+		 && cache->bytes + maxrec > SVC_DG_POOL_CACHE_BYTES)
+			break;
+		TAILQ_REMOVE(&svc_dg_pool.qh, have, q);
+		(svc_dg_pool.qcount)--;
+		svc_dg_pool_bytes -= maxrec;
+		TAILQ_INSERT_TAIL(&cache->qh, have, q);
+		(cache->qcount)++;
+		cache->bytes += maxrec;
+	}
+	pthread_mutex_unlock(&svc_dg_pool.qmutex);
+}
+
+static void
+svc_dg_cache_free(void *arg)
+{
+	struct svc_dg_cache *cache = arg;
+
+	/* a later put() makes another, freed on the next destructor pass */
+	svc_dg_cache_self = NULL;
+
+	svc_dg_cache_flush(cache);
+	mem_free(cache, sizeof(*cache));
+}
+
+static void
+svc_dg_pool_init(void)
+{
+	poolq_head_setup(&svc_dg_pool);
+	thr_keycreate(&svc_dg_cache_key, svc_dg_cache_free);
+}
+
+static inline struct svc_dg_cache *
+svc_dg_cache(void)
+{
+	struct svc_dg_cache *cache = svc_dg_cache_self;
+
+	if (likely(cache))
+		return (cache);
+
+	cache = mem_zalloc(sizeof(*cache));
+	TAILQ_INIT(&cache->qh);
+	thr_setspecific(svc_dg_cache_key, cache);
+	svc_dg_cache_self = cache;
+	return (cache);
+}
+
+/*
+ * Back to the state of svc_dg_xprt_zalloc(), keeping the initialized
+ * locks, conditions and queue heads.
+ */
+static void
+svc_dg_xprt_reset(struct svc_dg_xprt *su)
+{
+	struct rpc_dplx_rec *rec = &su->su_dr;
+	SVCXPRT *xprt = &rec->xprt;
+
+	/* as xdr_ioq_setup() */
+	XDR_DESTROY(rec->ioq.xdrs);
+	memset(rec->ioq.xdrs, 0, sizeof(rec->ioq.xdrs));
+	rec->ioq.xdrs->x_ops = &xdr_ioq_ops;
+	rec->ioq.xdrs->x_op = XDR_ENCODE;
+	rec->ioq.xdrs->x_flags = XDR_FLAG_VIO;
+	memset(&rec->ioq.ioq_wpe, 0, sizeof(rec->ioq.ioq_wpe));
+	TAILQ_INIT_ENTRY(&rec->ioq.ioq_s, q);
+	rec->ioq.ioq_s.qflags = IOQ_FLAG_SEGMENT;
+
+#if defined(HAVE_BLKIN)
+	if (xprt->blkin.svc_name)
+		mem_free(xprt->blkin.svc_name, 2*INET6_ADDRSTRLEN);
+	memset(&xprt->blkin, 0, sizeof(xprt->blkin));
+#endif
+	xprt->xp_ops = NULL;
+	xprt->xp_dispatch.process_cb = NULL;
+	xprt->xp_parent = NULL;
+	xprt->xp_tp = NULL;
+	xprt->xp_netid = NULL;
+	xprt->xp_p1 = NULL;
+	xprt->xp_p2 = NULL;
+	xprt->xp_p3 = NULL;
+	xprt->xp_u1 = NULL;
+	xprt->xp_u2 = NULL;
+	memset(&xprt->xp_local, 0, sizeof(xprt->xp_local));
+	memset(&xprt->xp_remote, 0, sizeof(xprt->xp_remote));
+	xprt->xp_fd = 0;
+	xprt->xp_ifindex = 0;
+	xprt->xp_si_type = 0;
+	xprt->xp_type = 0;
+	xprt->xp_flags = 0;
+
+	opr_rbtree_init(&rec->call_replies, clnt_req_xid_cmpf);
+	memset(&rec->ev_u, 0, sizeof(rec->ev_u));
+	rec->ev_p = NULL;
+	rec->retire_epoch = 0;
+	timer_wheel_entry_init(&rec->idle_q);
+	rec->idle_off = true;
+	rec->call_xid = 0;
+	rec->ev_count = 0;
+	rec->ev_events = 0;
+	rec->sendq_bytes = 0;
+	memset(&rec->sendq_paused, 0, sizeof(rec->sendq_paused));
+	/* au_cache is keyed on the raw credential, so kept */
+
+	memset(&su->su_msghdr, 0, sizeof(su->su_msghdr));
+	memset(su->su_cmsg, 0, sizeof(su->su_cmsg));
+	memset(&su->su_iov, 0, sizeof(su->su_iov));
+}
+
+static struct svc_dg_xprt *
+svc_dg_xprt_get(size_t iosz)
+{
+	struct svc_dg_cache *cache;
+	struct poolq_entry *have;
+	struct svc_dg_xprt *su;
+
+	pthread_once(&svc_dg_pool_once, svc_dg_pool_init);
+	cache = svc_dg_cache();
+
+	for (;;) {
+		if (unlikely(!cache->qcount))
+			svc_dg_cache_fill(cache);
+
+		have = TAILQ_FIRST(&cache->qh);
+		if (!have)
+			return (svc_dg_xprt_zalloc(iosz));
+
+		TAILQ_REMOVE(&cache->qh, have, q);
+		su = SU_(have);
+		(cache->qcount)--;
+		cache->bytes -= su->su_dr.maxrec;
+		if (likely(su->su_dr.maxrec == iosz))
+			break;
+		svc_dg_xprt_free(su);
+	}
+
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &(su->su_dr.recv.ts));
+	su->su_dr.xprt.xp_refcnt = 1;
+
+	/* Extra ref, svc_dg_recv will call DESTROY and RELEASE */
+	SVC_REF(&su->su_dr.xprt, SVC_REF_FLAG_NONE);
+	return (su);
+}
+
+static void
+svc_dg_xprt_put(struct svc_dg_xprt *su)
+{
+	struct svc_dg_cache *cache = svc_dg_cache();
+	size_t maxrec = su->su_dr.maxrec;
+
+	svc_dg_xprt_reset(su);
+	su->su_dr.maxrec = maxrec;
+
+	/* full:  hand the batch to the (allocating) thread that refills */
+	if (cache->qcount >= SVC_DG_POOL_CACHE
+	 || (cache->qcount
+	  && cache->bytes + maxrec > SVC_DG_POOL_CACHE_BYTES))
+		svc_dg_cache_flush(cache);
+
+	TAILQ_INSERT_HEAD(&cache->qh, &su->su_dr.ioq.ioq_s, q);
+	(cache->qcount)++;
+	cache->bytes += maxrec;
+}
+
 static void
 svc_dg_xprt_setup(SVCXPRT **sxpp)
 {
@@ -266,17 +497,16 @@ static void svc_dg_set_pktinfo(struct cmsghdr *cmsg, SVCXPRT *xprt)
 	}
 }
 
-static enum xprt_stat
-svc_dg_rendezvous(SVCXPRT *xprt)
+/*
+ * Datagram context, for one request on the rendezvous transport
+ */
+static struct svc_dg_xprt *
+svc_dg_rendezvous_alloc(SVCXPRT *xprt)
 {
 	struct svc_dg_xprt *req_su = su_data(xprt);
-	struct svc_dg_xprt *su = svc_dg_xprt_zalloc(req_su->su_dr.maxrec);
+	struct svc_dg_xprt *su = svc_dg_xprt_get(req_su->su_dr.maxrec);
 	SVCXPRT *newxprt = &su->su_dr.xprt;
-	struct sockaddr *sp = (struct sockaddr *)&newxprt->xp_remote.ss;
-	struct msghdr *mesgp;
 	struct timespec now;
-	struct iovec iov;
-	ssize_t rlen;
 
 	newxprt->xp_fd = xprt->xp_fd;
 	newxprt->xp_flags = SVC_XPRT_FLAG_INITIAL | SVC_XPRT_FLAG_INITIALIZED;
@@ -287,41 +517,34 @@ svc_dg_rendezvous(SVCXPRT *xprt)
 	su->su_dr.recvsz = req_su->su_dr.recvsz;
 	su->su_dr.maxrec = req_su->su_dr.maxrec;
 	svc_dg_override_ops(newxprt, xprt);
+	return (su);
+}
 
- again:
-	iov.iov_base = &su[1];
-	iov.iov_len = su->su_dr.maxrec;
-	mesgp = &su->su_msghdr;
+static void
+svc_dg_rendezvous_msghdr(struct svc_dg_xprt *su, struct msghdr *mesgp)
+{
+	struct sockaddr *sp = (struct sockaddr *)&su->su_dr.xprt.xp_remote.ss;
+
+	su->su_iov.iov_base = &su[1];
+	su->su_iov.iov_len = su->su_dr.maxrec;
 	memset(mesgp, 0, sizeof(*mesgp));
-	mesgp->msg_iov = &iov;
+	mesgp->msg_iov = &su->su_iov;
 	mesgp->msg_iovlen = 1;
 	mesgp->msg_name = sp;
 	sp->sa_family = (sa_family_t) 0xffff;
 	mesgp->msg_namelen = sizeof(struct sockaddr_storage);
 	mesgp->msg_control = su->su_cmsg;
 	mesgp->msg_controllen = sizeof(su->su_cmsg);
+}
 
-	rlen = recvmsg(newxprt->xp_fd, mesgp, 0);
-
-	if (sp->sa_family == (sa_family_t) 0xffff) {
-		svc_dg_xprt_free(su);
-		return (XPRT_DIED);
-	}
-
-	if (rlen == -1 && errno == EINTR)
-		goto again;
-	if (rlen == -1 || (rlen < (ssize_t) (4 * sizeof(u_int32_t)))) {
-		svc_dg_xprt_free(su);
-		return (XPRT_DIED);
-	}
-
-	if (unlikely(svc_rqst_rearm_events(xprt))) {
-		__warnx(TIRPC_DEBUG_FLAG_ERROR,
-			"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
-			__func__, xprt, xprt->xp_fd);
-		svc_dg_xprt_free(su);
-		return (XPRT_DIED);
-	}
+/*
+ * Received datagram, ready for dispatch
+ */
+static void
+svc_dg_rendezvous_ready(SVCXPRT *xprt, struct svc_dg_xprt *su)
+{
+	SVCXPRT *newxprt = &su->su_dr.xprt;
+	struct msghdr *mesgp = &su->su_msghdr;
 
 	__rpc_address_setup(&newxprt->xp_local);
 	__rpc_address_setup(&newxprt->xp_remote);
@@ -340,11 +563,195 @@ svc_dg_rendezvous(SVCXPRT *xprt)
 	__rpc_set_blkin_endpoint(newxprt, "svc_dg");
 #endif
 
-	xdrmem_create(su->su_dr.ioq.xdrs, iov.iov_base, iov.iov_len,
-		      XDR_DECODE);
+	xdrmem_create(su->su_dr.ioq.xdrs, su->su_iov.iov_base,
+		      su->su_iov.iov_len, XDR_DECODE);
 
 	SVC_REF(xprt, SVC_REF_FLAG_NONE);
 	newxprt->xp_parent = xprt;
+}
+
+/*
+ * SVC_FLAG_DG_BATCH
+ *
+ * The rendezvous transport receives up to __svc_params->dg_batch
+ * datagrams per event with one recvmmsg(), into contexts kept from
+ * previous events.  Every datagram but the last is handed to the work
+ * pool; the last is dispatched inline, after the events are re-armed.
+ *
+ * Replies are queued on the rendezvous sendq.  The first replier sends
+ * the queue with sendmmsg() until it is empty, as svc_ioq_write() does
+ * for streams.
+ */
+struct svc_dg_batch {
+	u_int max;
+	struct mmsghdr *msgs;
+	struct work_pool_entry **wpes;
+	struct svc_dg_xprt *su[];
+};
+
+static struct svc_dg_batch *
+svc_dg_batch_create(u_int max)
+{
+	struct svc_dg_batch *batch =
+		mem_zalloc(sizeof(struct svc_dg_batch)
+			   + max * (sizeof(struct svc_dg_xprt *)
+				    + sizeof(struct mmsghdr)
+				    + sizeof(struct work_pool_entry *)));
+
+	batch->max = max;
+	batch->msgs = (struct mmsghdr *)&batch->su[max];
+	batch->wpes = (struct work_pool_entry **)&batch->msgs[max];
+	return (batch);
+}
+
+static void
+svc_dg_batch_destroy(struct svc_dg_batch *batch)
+{
+	u_int i;
+
+	for (i = 0; i < batch->max; i++) {
+		if (batch->su[i])
+			svc_dg_xprt_put(batch->su[i]);
+	}
+	mem_free(batch, sizeof(struct svc_dg_batch)
+		 + batch->max * (sizeof(struct svc_dg_xprt *)
+				 + sizeof(struct mmsghdr)
+				 + sizeof(struct work_pool_entry *)));
+}
+
+static void
+svc_dg_rendezvous_task(struct work_pool_entry *wpe)
+{
+	struct rpc_dplx_rec *rec =
+			opr_containerof(wpe, struct rpc_dplx_rec, ioq.ioq_wpe);
+	SVCXPRT *xprt = &rec->xprt;
+
+	(void)xprt->xp_parent->xp_dispatch.rendezvous_cb(xprt);
+}
+
+static enum xprt_stat
+svc_dg_rendezvous_batch(SVCXPRT *xprt)
+{
+	struct svc_dg_xprt *req_su = su_data(xprt);
+	struct svc_dg_batch *batch = req_su->su_batch;
+	struct svc_dg_xprt *ready = NULL;
+	struct svc_dg_xprt *su;
+	struct mmsghdr *mmsg;
+	u_int n_wpes = 0;
+	u_int i;
+	int n;
+
+	if (unlikely(!batch)) {
+		batch = svc_dg_batch_create(__svc_params->dg_batch);
+		req_su->su_batch = batch;
+	}
+
+	/* no need for locking, only one svc_rqst_xprt_task() per event */
+	for (i = 0; i < batch->max; i++) {
+		if (!batch->su[i])
+			batch->su[i] = svc_dg_rendezvous_alloc(xprt);
+		svc_dg_rendezvous_msghdr(batch->su[i], &batch->msgs[i].msg_hdr);
+	}
+
+ again:
+	n = recvmmsg(xprt->xp_fd, batch->msgs, batch->max, MSG_DONTWAIT,
+		     NULL);
+	if (n < 0) {
+		if (errno == EINTR)
+			goto again;
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: %p fd %d recvmmsg errno %d",
+				__func__, xprt, xprt->xp_fd, errno);
+			return (XPRT_DIED);
+		}
+		n = 0;
+	}
+
+	for (i = 0; i < (u_int)n; i++) {
+		mmsg = &batch->msgs[i];
+		su = batch->su[i];
+
+		/* unusable contexts are kept for the next event */
+		if (((struct sockaddr *)mmsg->msg_hdr.msg_name)->sa_family
+		    == (sa_family_t) 0xffff
+		 || mmsg->msg_len < (4 * sizeof(u_int32_t)))
+			continue;
+
+		batch->su[i] = NULL;
+		su->su_msghdr = mmsg->msg_hdr;
+		svc_dg_rendezvous_ready(xprt, su);
+		su->su_dr.ioq.ioq_wpe.fun = svc_dg_rendezvous_task;
+
+		if (ready)
+			batch->wpes[n_wpes++] = &ready->su_dr.ioq.ioq_wpe;
+		ready = su;
+	}
+
+	/* batch is reused by the next event, after re-arming */
+	if (n_wpes)
+		work_pool_submit_batch(svc_rqst_work_pool(xprt),
+				       batch->wpes, n_wpes);
+
+	if (unlikely(svc_rqst_rearm_events(xprt))) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		if (ready)
+			work_pool_submit(svc_rqst_work_pool(xprt),
+					 &ready->su_dr.ioq.ioq_wpe);
+		return (XPRT_DIED);
+	}
+
+	if (!ready)
+		return (XPRT_IDLE);
+
+	return (xprt->xp_dispatch.rendezvous_cb(&ready->su_dr.xprt));
+}
+
+static enum xprt_stat
+svc_dg_rendezvous(SVCXPRT *xprt)
+{
+	struct svc_dg_xprt *su;
+	SVCXPRT *newxprt;
+	struct sockaddr *sp;
+	struct msghdr *mesgp;
+	ssize_t rlen;
+
+	if (__svc_params->flags & SVC_FLAG_DG_BATCH)
+		return (svc_dg_rendezvous_batch(xprt));
+
+	su = svc_dg_rendezvous_alloc(xprt);
+	newxprt = &su->su_dr.xprt;
+	sp = (struct sockaddr *)&newxprt->xp_remote.ss;
+	mesgp = &su->su_msghdr;
+
+ again:
+	svc_dg_rendezvous_msghdr(su, mesgp);
+
+	rlen = recvmsg(newxprt->xp_fd, mesgp, 0);
+
+	if (sp->sa_family == (sa_family_t) 0xffff) {
+		svc_dg_xprt_put(su);
+		return (XPRT_DIED);
+	}
+
+	if (rlen == -1 && errno == EINTR)
+		goto again;
+	if (rlen == -1 || (rlen < (ssize_t) (4 * sizeof(u_int32_t)))) {
+		svc_dg_xprt_put(su);
+		return (XPRT_DIED);
+	}
+
+	if (unlikely(svc_rqst_rearm_events(xprt))) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		svc_dg_xprt_put(su);
+		return (XPRT_DIED);
+	}
+
+	svc_dg_rendezvous_ready(xprt, su);
 	return (xprt->xp_dispatch.rendezvous_cb(newxprt));
 }
 
@@ -405,17 +812,94 @@ svc_dg_decode(struct svc_req *req)
 	return (XPRT_DIED);
 }
 
+/*
+ * Account for n sent replies, then dequeue the next, if any.
+ */
+static inline struct svc_dg_xprt *
+svc_dg_reply_next(struct poolq_head *ifph, u_int n)
+{
+	struct poolq_entry *have;
+
+	mutex_lock(&ifph->qmutex);
+	ifph->qcount -= n;
+	if (ifph->qcount == 0) {
+		mutex_unlock(&ifph->qmutex);
+		return (NULL);
+	}
+
+	have = TAILQ_FIRST(&ifph->qh);
+	TAILQ_REMOVE(&ifph->qh, have, q);
+	mutex_unlock(&ifph->qmutex);
+
+	return (opr_containerof(have, struct svc_dg_xprt, su_dr.ioq.ioq_s));
+}
+
+/*
+ * SVC_FLAG_DG_BATCH reply.  Each queued reply holds a ref on its
+ * datagram transport, and so on the rendezvous transport.
+ */
 static void
-svc_dg_checksum(struct svc_req *req, void *data, size_t length)
+svc_dg_reply_batch(SVCXPRT *xprt, struct svc_dg_xprt *su)
 {
-	req->rq_cksum =
-#if 1
-	/* CithHash64 is -substantially- faster than crc32c from FreeBSD
-	 * SCTP, so prefer it until fast crc32c bests it */
-		CityHash64WithSeed(data, MIN(256, length), 103);
-#else
-		calculate_crc32c(0, data, MIN(256, length));
-#endif
+	SVCXPRT *parent = xprt->xp_parent;
+	struct poolq_head *ifph = &parent->sendq;
+	struct svc_dg_xprt *sus[SVC_DG_BATCH_MAX];
+	struct mmsghdr msgs[SVC_DG_BATCH_MAX];
+	struct poolq_entry *have;
+	u_int max = __svc_params->dg_batch;
+	u_int n;
+	u_int i;
+	int rc;
+
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+
+	mutex_lock(&ifph->qmutex);
+	if ((ifph->qcount)++ > 0) {
+		/* the active writer sends it */
+		TAILQ_INSERT_TAIL(&ifph->qh, &su->su_dr.ioq.ioq_s, q);
+		mutex_unlock(&ifph->qmutex);
+		return;
+	}
+	mutex_unlock(&ifph->qmutex);
+
+	do {
+		sus[0] = su;
+		n = 1;
+
+		mutex_lock(&ifph->qmutex);
+		while (n < max && (have = TAILQ_FIRST(&ifph->qh))) {
+			TAILQ_REMOVE(&ifph->qh, have, q);
+			sus[n++] = opr_containerof(have, struct svc_dg_xprt,
+						   su_dr.ioq.ioq_s);
+		}
+		mutex_unlock(&ifph->qmutex);
+
+		for (i = 0; i < n; i++) {
+			msgs[i].msg_hdr = sus[i]->su_msghdr;
+			msgs[i].msg_len = 0;
+		}
+
+		/* do i/o unlocked */
+		for (i = 0; i < n; i += rc) {
+			rc = sendmmsg(parent->xp_fd, &msgs[i], n - i, 0);
+			if (rc > 0)
+				continue;
+			if (rc < 0 && errno == EINTR) {
+				rc = 0;
+				continue;
+			}
+			/* skip the failed reply, as a lost datagram */
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: %p fd %d sendmmsg errno %d",
+				__func__, &sus[i]->su_dr.xprt, parent->xp_fd,
+				errno);
+			rc = 1;
+		}
+
+		for (i = 0; i < n; i++)
+			SVC_RELEASE(&sus[i]->su_dr.xprt,
+				    SVC_RELEASE_FLAG_NONE);
+	} while ((su = svc_dg_reply_next(ifph, n)));
 }
 
 static enum xprt_stat
@@ -456,6 +940,25 @@ svc_dg_reply(struct svc_req *req)
 			__func__, xprt, xprt->xp_fd);
 		return (XPRT_DIED);
 	}
+
+	if ((__svc_params->flags & SVC_FLAG_DG_BATCH) && xprt->xp_parent) {
+		/* queued, so the received control data is reused */
+		memset(su->su_cmsg, 0, sizeof(su->su_cmsg));
+		su->su_iov.iov_base = &su[1];
+		su->su_iov.iov_len = XDR_GETPOS(xdrs);
+		msg->msg_iov = &su->su_iov;
+		msg->msg_iovlen = 1;
+		msg->msg_name = (struct sockaddr *)&xprt->xp_remote.ss;
+		msg->msg_namelen = xprt->xp_remote.nb.len;
+		msg->msg_control = su->su_cmsg;
+		cmsg = (struct cmsghdr *)msg->msg_control;
+		svc_dg_set_pktinfo(cmsg, xprt);
+		msg->msg_controllen = CMSG_ALIGN(cmsg->cmsg_len);
+
+		svc_dg_reply_batch(xprt, su);
+		return (XPRT_IDLE);
+	}
+
 	iov.iov_base = &su[1];
 	iov.iov_len = slen = XDR_GETPOS(xdrs);
 	msg->msg_iov = &iov;
@@ -491,11 +994,15 @@ svc_dg_destroy_task(struct work_pool_entry *wpe)
 		"%s() %p fd %d xp_refcnt %" PRId32,
 		__func__, xprt, xprt->xp_fd, xprt->xp_refcnt);
 
-	if (rec->xprt.xp_refcnt) {
-		/* instead of nanosleep */
-		work_pool_submit(&svc_work_pool, &(rec->ioq.ioq_wpe));
+	if (rec->xprt.xp_parent) {
+		/* per-request, never published:  no lookup can hold it */
+		if (rec->xprt.xp_refcnt) {
+			/* instead of nanosleep */
+			work_pool_submit(&svc_work_pool, &(rec->ioq.ioq_wpe));
+			return;
+		}
+	} else if (!svc_xprt_retired(&rec->xprt))
 		return;
-	}
 
 	xp_flags = atomic_postclear_uint16_t_bits(&rec->xprt.xp_flags,
 						  SVC_XPRT_FLAG_CLOSE);
@@ -516,7 +1023,13 @@ svc_dg_destroy_task(struct work_pool_entry *wpe)
 	if (rec->xprt.xp_parent)
 		SVC_RELEASE(rec->xprt.xp_parent, SVC_RELEASE_FLAG_NONE);
 
-	svc_dg_xprt_free(DG_DR(rec));
+	if (DG_DR(rec)->su_batch)
+		svc_dg_batch_destroy(DG_DR(rec)->su_batch);
+
+	if (rec->xprt.xp_parent)
+		svc_dg_xprt_put(DG_DR(rec));
+	else
+		svc_dg_xprt_free(DG_DR(rec));
 }
 
 static void
@@ -598,7 +1111,7 @@ svc_dg_override_ops(SVCXPRT *xprt, SVCXPRT *rendezvous)
 		ops.xp_stat = svc_dg_stat;
 		ops.xp_decode = svc_dg_decode;
 		ops.xp_reply = svc_dg_reply;
-		ops.xp_checksum = svc_dg_checksum;
+		ops.xp_checksum = svc_cksum;
 		ops.xp_unlink = svc_dg_unlink_it;
 		ops.xp_destroy = svc_dg_destroy_it;
 		ops.xp_control = svc_dg_control;
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2019 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file svc_epoch.c
+ * @brief Epoch-based reclamation
+ *
+ * @section DESCRIPTION
+ *
+ * The global epoch advances when every thread inside a section has
+ * entered it at the current epoch.  An object stamped at epoch E is
+ * then safe at E + 2:  the readers of E and earlier have all left.
+ *
+ * Threads register on their first section, and unregister at exit.
+ *
+ * Deferred tasks wait in limbo lists by epoch.  The epoch is advanced
+ * at most once per SVC_EPOCH_POLL_MS, from section exits and the
+ * reaper while tasks are deferred, so that each retired object does
+ * not walk the threads.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <rpc/types.h>
+#include <reentrant.h>
+#include <misc/portable.h>
+#include <misc/abstract_atomic.h>
+#include <misc/opr.h>
+#include <misc/timespec.h>
+#include <rpc/svc.h>
+#include <rpc/work_pool.h>
+
+#include "svc_epoch.h"
+
+#define SVC_EPOCH_POLL_MS 1
+#define SVC_EPOCH_LIMBO 3	/* safe at epoch + 2 */
+
+uint64_t svc_epoch_global = 1;
+__thread struct svc_epoch_thr *svc_epoch_self;
+uint32_t svc_epoch_deferred;
+
+static struct svc_epoch_limbo {
+	mutex_t mtx;
+	struct poolq_head_s q[SVC_EPOCH_LIMBO];
+	uint64_t epoch[SVC_EPOCH_LIMBO];
+} svc_epoch_limbo = {
+	.mtx = MUTEX_INITIALIZER,
+};
+static uint64_t svc_epoch_poll_ms;
+
+static mutex_t svc_epoch_mtx = MUTEX_INITIALIZER;
+static TAILQ_HEAD(, svc_epoch_thr) svc_epoch_thrs =
+	TAILQ_HEAD_INITIALIZER(svc_epoch_thrs);
+static pthread_once_t svc_epoch_once = PTHREAD_ONCE_INIT;
+static thread_key_t svc_epoch_key;
+
+static void
+svc_epoch_thr_free(void *arg)
+{
+	struct svc_epoch_thr *thr = arg;
+
+	mutex_lock(&svc_epoch_mtx);
+	TAILQ_REMOVE(&svc_epoch_thrs, thr, q);
+	mutex_unlock(&svc_epoch_mtx);
+
+	svc_epoch_self = NULL;
+	mem_free(thr, sizeof(*thr));
+}
+
+static void
+svc_epoch_init(void)
+{
+	int ix;
+
+	thr_keycreate(&svc_epoch_key, svc_epoch_thr_free);
+	for (ix = 0; ix < SVC_EPOCH_LIMBO; ix++)
+		TAILQ_INIT(&svc_epoch_limbo.q[ix]);
+}
+
+struct svc_epoch_thr *
+svc_epoch_register(void)
+{
+	struct svc_epoch_thr *thr = mem_zalloc(sizeof(*thr));
+
+	pthread_once(&svc_epoch_once, svc_epoch_init);
+
+	mutex_lock(&svc_epoch_mtx);
+	TAILQ_INSERT_TAIL(&svc_epoch_thrs, thr, q);
+	mutex_unlock(&svc_epoch_mtx);
+
+	thr_setspecific(svc_epoch_key, thr);
+	svc_epoch_self = thr;
+	return (thr);
+}
+
+/*
+ * Advance once, when no section lags the current epoch.
+ * svc_epoch_mtx held.
+ */
+static void
+svc_epoch_advance_locked(void)
+{
+	struct svc_epoch_thr *thr;
+	uint64_t epoch;
+	uint64_t active;
+
+	epoch = atomic_fetch_uint64_t(&svc_epoch_global);
+	TAILQ_FOREACH(thr, &svc_epoch_thrs, q) {
+		active = atomic_fetch_uint64_t(&thr->active);
+		if (active && active != epoch)
+			return;
+	}
+	atomic_store_uint64_t(&svc_epoch_global, epoch + 1);
+}
+
+static void
+svc_epoch_advance(void)
+{
+	mutex_lock(&svc_epoch_mtx);
+	svc_epoch_advance_locked();
+	mutex_unlock(&svc_epoch_mtx);
+}
+
+bool
+svc_epoch_safe(uint64_t stamp)
+{
+	int tries;
+
+	for (tries = 0; tries < 2; tries++) {
+		if (svc_epoch_passed(stamp))
+			return true;
+		svc_epoch_advance();
+	}
+	return (svc_epoch_passed(stamp));
+}
+
+/*
+ * Run wpe on svc_work_pool once every section active now has exited.
+ * Returns true when no other task was deferred, for a caller that
+ * should wake the reaper.
+ */
+bool
+svc_epoch_defer(struct work_pool_entry *wpe)
+{
+	uint64_t epoch;
+	int ix;
+
+	pthread_once(&svc_epoch_once, svc_epoch_init);
+
+	mutex_lock(&svc_epoch_limbo.mtx);
+	epoch = atomic_fetch_uint64_t(&svc_epoch_global);
+	ix = epoch % SVC_EPOCH_LIMBO;
+
+	/* a list left from an earlier epoch is only delayed */
+	svc_epoch_limbo.epoch[ix] = epoch;
+	TAILQ_INSERT_TAIL(&svc_epoch_limbo.q[ix], &wpe->pqe, q);
+	mutex_unlock(&svc_epoch_limbo.mtx);
+
+	if (atomic_inc_uint32_t(&svc_epoch_deferred) > 1)
+		return (false);
+
+	svc_epoch_poll();
+	return (true);
+}
+
+/*
+ * Advance the epoch, at most once per SVC_EPOCH_POLL_MS, and submit the
+ * deferred tasks that are now safe.
+ */
+void
+svc_epoch_poll(void)
+{
+	struct poolq_head_s ready;
+	struct poolq_entry *have;
+	struct timespec ts;
+	uint64_t epoch;
+	uint64_t now;
+	int ix;
+
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &ts);
+	now = timespec_ms(&ts);
+	if (now < atomic_fetch_uint64_t(&svc_epoch_poll_ms)
+	 || mutex_trylock(&svc_epoch_mtx))
+		return;
+	if (now < svc_epoch_poll_ms) {
+		/* raced */
+		mutex_unlock(&svc_epoch_mtx);
+		return;
+	}
+	atomic_store_uint64_t(&svc_epoch_poll_ms, now + SVC_EPOCH_POLL_MS);
+	svc_epoch_advance_locked();
+	mutex_unlock(&svc_epoch_mtx);
+
+	TAILQ_INIT(&ready);
+	epoch = atomic_fetch_uint64_t(&svc_epoch_global);
+	mutex_lock(&svc_epoch_limbo.mtx);
+	for (ix = 0; ix < SVC_EPOCH_LIMBO; ix++) {
+		if (svc_epoch_limbo.epoch[ix] + 2 <= epoch)
+			TAILQ_CONCAT(&ready, &svc_epoch_limbo.q[ix], q);
+	}
+	mutex_unlock(&svc_epoch_limbo.mtx);
+
+	while ((have = TAILQ_FIRST(&ready))) {
+		TAILQ_REMOVE(&ready, have, q);
+		atomic_dec_uint32_t(&svc_epoch_deferred);
+		work_pool_submit(&svc_work_pool,
+				 opr_containerof(have, struct work_pool_entry,
+						 pqe));
+	}
+}
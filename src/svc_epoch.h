@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2019 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file svc_epoch.h
+ * @brief Epoch-based reclamation
+ *
+ * Readers bracket lock-free accesses with svc_epoch_enter() and
+ * svc_epoch_exit(), which only store to a per-thread record.  A writer
+ * unpublishes an object, stamps it with svc_epoch_stamp(), and frees
+ * it once svc_epoch_safe() is true:  every reader active at the stamp
+ * has left its section.  Frequent retirements instead hand a task to
+ * svc_epoch_defer(), which runs it once safe.
+ */
+
+#ifndef SVC_EPOCH_H
+#define SVC_EPOCH_H
+
+#include <stdbool.h>
+#include <intrinsic.h>
+#include <misc/queue.h>
+#include <misc/abstract_atomic.h>
+
+struct svc_epoch_thr {
+	TAILQ_ENTRY(svc_epoch_thr) q;
+	uint64_t active;	/* epoch entered, or 0 */
+	uint32_t depth;		/* nested sections */
+};
+
+struct work_pool_entry;
+
+extern uint64_t svc_epoch_global;
+extern __thread struct svc_epoch_thr *svc_epoch_self;
+extern uint32_t svc_epoch_deferred;
+
+struct svc_epoch_thr *svc_epoch_register(void);
+bool svc_epoch_safe(uint64_t stamp);
+bool svc_epoch_defer(struct work_pool_entry *wpe);
+void svc_epoch_poll(void);
+
+static inline void
+svc_epoch_enter(void)
+{
+	struct svc_epoch_thr *thr = svc_epoch_self;
+
+	if (unlikely(!thr))
+		thr = svc_epoch_register();
+	if (thr->depth++)
+		return;
+
+	/* ordered before the loads that follow */
+	atomic_store_uint64_t(&thr->active,
+			      atomic_fetch_uint64_t(&svc_epoch_global));
+}
+
+static inline void
+svc_epoch_exit(void)
+{
+	struct svc_epoch_thr *thr = svc_epoch_self;
+
+	if (--thr->depth)
+		return;
+	atomic_store_uint64_t(&thr->active, 0);
+
+	if (unlikely(atomic_fetch_uint32_t(&svc_epoch_deferred)))
+		svc_epoch_poll();
+}
+
+/*
+ * Every reader that could see an object stamped at stamp has left.
+ */
+static inline bool
+svc_epoch_passed(uint64_t stamp)
+{
+	return (atomic_fetch_uint64_t(&svc_epoch_global) >= stamp + 2);
+}
+
+/*
+ * After unpublishing:  readers that could still see the object are in
+ * sections entered no later than this epoch.
+ */
+static inline uint64_t
+svc_epoch_stamp(void)
+{
+	return (atomic_fetch_uint64_t(&svc_epoch_global));
+}
+
+#endif				/* SVC_EPOCH_H */
@@ -50,8 +50,14 @@
 #include <unistd.h>
 #include <err.h>
 
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
+
 #include "rpc_com.h"
 #include <rpc/svc.h>
+#include <rpc/svc_rqst.h>
+#include "svc_internal.h"
 
 extern int __svc_vc_setflag(SVCXPRT *, int);
 
@@ -305,3 +311,174 @@ svc_tli_ncreate(int fd,	/* Connection end point */
 	}
 	return (NULL);
 }
+
+/*
+ * Steer each connection or datagram to the socket at the index of the
+ * receiving CPU, modulo count: ld #cpu; mod #count; ret a.  Sockets join
+ * the group in the order they were bound.
+ */
+static void
+svc_reuseport_steer(int fd, u_int count)
+{
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_AD_CPU)
+	struct sock_filter code[] = {
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, count },
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog prog = {
+		.len = sizeof(code) / sizeof(code[0]),
+		.filter = code,
+	};
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+		       sizeof(prog)) < 0) {
+		__warnx(TIRPC_DEBUG_FLAG_WARN,
+			"%s: fd %d SO_ATTACH_REUSEPORT_CBPF failed (%d), using hash",
+			__func__, fd, errno);
+	}
+#else
+	__warnx(TIRPC_DEBUG_FLAG_WARN,
+		"%s: fd %d CPU steering unsupported, using hash",
+		__func__, fd);
+#endif
+}
+
+/*
+ * Creates count SO_REUSEPORT sockets bound to one address, each on
+ * its own event channel, so that accept() or datagram receive for a
+ * single service address is spread over the channel threads.
+ *
+ * With SVC_REUSEPORT_FLAG_EVCHAN, a new channel is created for each
+ * socket and returned in chan_ids; otherwise chan_ids are the channels
+ * to use.  Connections inherit the channel of their listener.
+ *
+ * rendezvous_cb (if any) is set before the transport is registered.
+ *
+ * Returns 0, or an errno; either all or none of the transports exist.
+ */
+int
+svc_reuseport_ncreate(const struct netconfig *nconf,
+		      const struct t_bind *bindaddr,
+		      const u_int sendsz, const u_int recvsz,
+		      const u_int count, uint32_t *chan_ids,
+		      SVCXPRT **xprts, svc_xprt_fun_t rendezvous_cb,
+		      const uint32_t flags)
+{
+	struct __rpc_sockinfo si;
+	SVCXPRT *xprt;
+	u_int chans = 0;	/* created here */
+	u_int ix;
+	int code = 0;
+	int val = 1;
+	int fd;
+
+	if (!nconf || !bindaddr || !count
+	 || !__rpc_nconf2sockinfo(nconf, &si)) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC,
+			"%s: invalid arguments", __func__);
+		return (EINVAL);
+	}
+
+	for (ix = 0; ix < count; ix++) {
+		xprts[ix] = NULL;
+	}
+
+	for (ix = 0; ix < count; ix++) {
+		fd = __rpc_nconf2fd(nconf);
+		if (fd < 0) {
+			code = errno;
+			__warnx(TIRPC_DEBUG_FLAG_SVC,
+				"%s: could not open socket for %s (%d)",
+				__func__, nconf->nc_netid, code);
+			goto freedata;
+		}
+
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &val,
+			       sizeof(val)) < 0
+		 || bind(fd, (struct sockaddr *)bindaddr->addr.buf,
+			 (socklen_t) si.si_alen) < 0) {
+			code = errno;
+			__warnx(TIRPC_DEBUG_FLAG_SVC,
+				"%s: could not bind %s socket %u (%d)",
+				__func__, nconf->nc_netid, ix, code);
+			(void)close(fd);
+			goto freedata;
+		}
+
+		switch (si.si_socktype) {
+		case SOCK_STREAM:
+			listen(fd, bindaddr->qlen ? (int)bindaddr->qlen
+						  : SOMAXCONN);
+			xprt = svc_vc_ncreatef(fd, sendsz, recvsz,
+					       SVC_CREATE_FLAG_CLOSE |
+					       SVC_CREATE_FLAG_XPRT_NOREG);
+			break;
+		case SOCK_DGRAM:
+			xprt = svc_dg_ncreatef(fd, sendsz, recvsz,
+					       SVC_CREATE_FLAG_CLOSE |
+					       SVC_CREATE_FLAG_XPRT_NOREG);
+			break;
+		default:
+			xprt = NULL;
+			break;
+		}
+
+		if (!xprt) {
+			code = EINVAL;
+			__warnx(TIRPC_DEBUG_FLAG_SVC,
+				"%s: could not create %s transport %u",
+				__func__, nconf->nc_netid, ix);
+			(void)close(fd);
+			goto freedata;
+		}
+		xprts[ix] = xprt;
+
+		xprt->xp_si_type = __rpc_socktype2seman(si.si_socktype);
+		if (!xprt->xp_netid)
+			xprt->xp_netid = mem_strdup(nconf->nc_netid);
+		xprt->xp_tp = mem_strdup(nconf->nc_device);
+
+		if (flags & SVC_REUSEPORT_FLAG_EVCHAN) {
+			code = svc_rqst_new_evchan(&chan_ids[ix], NULL,
+						   SVC_RQST_FLAG_NONE);
+			if (code) {
+				__warnx(TIRPC_DEBUG_FLAG_SVC,
+					"%s: could not create channel %u (%d)",
+					__func__, ix, code);
+				goto freedata;
+			}
+			chans++;
+		}
+	}
+
+	if (flags & SVC_REUSEPORT_FLAG_CPU)
+		svc_reuseport_steer(xprts[0]->xp_fd, count);
+
+	for (ix = 0; ix < count; ix++) {
+		if (rendezvous_cb)
+			xprts[ix]->xp_dispatch.rendezvous_cb = rendezvous_cb;
+		code = svc_rqst_evchan_reg(chan_ids[ix], xprts[ix],
+					   SVC_RQST_FLAG_CHAN_AFFINITY);
+		if (code) {
+			__warnx(TIRPC_DEBUG_FLAG_SVC,
+				"%s: could not register transport %u on channel %"
+				PRIu32 " (%d)",
+				__func__, ix, chan_ids[ix], code);
+			goto freedata;
+		}
+	}
+
+	return (0);
+
+ freedata:
+	for (ix = 0; ix < count; ix++) {
+		if (xprts[ix]) {
+			SVC_DESTROY(xprts[ix]);
+			xprts[ix] = NULL;
+		}
+	}
+	for (ix = 0; ix < chans; ix++)
+		(void)svc_rqst_delete_evchan(chan_ids[ix]);
+	return (code);
+}
@@ -69,10 +69,14 @@ struct svc_params {
 		u_int send_max;
 		u_int thrd_max;
 		u_int thrd_min;
+		uint64_t sendq_budget;
+		uint64_t sendq_global;
 	} ioq;
 
 	u_long flags;
 	u_int max_connections;
+	u_int dg_batch;
+	u_int busy_poll_us;
 	int32_t idle_timeout;
 };
 
@@ -89,10 +93,14 @@ extern struct svc_params __svc_params[1];
  * Replaces old struct svc_dg_data by locally wrapping struct rpc_dplx_rec,
  * which wraps struct svc_xprt indexed by fd.
  */
+struct svc_dg_batch;
+
 struct svc_dg_xprt {
 	struct rpc_dplx_rec su_dr;	/* SVCXPRT indexed by fd */
 	struct msghdr su_msghdr;	/* msghdr received from clnt */
 	unsigned char su_cmsg[SVC_CMSG_SIZE];	/* cmsghdr received from clnt */
+	struct iovec su_iov;		/* SVC_FLAG_DG_BATCH queued reply */
+	struct svc_dg_batch *su_batch;	/* SVC_FLAG_DG_BATCH rendezvous */
 };
 #define DG_DR(p) (opr_containerof((p), struct svc_dg_xprt, su_dr))
 #define su_data(xprt) (DG_DR(REC_XPRT(xprt)))
@@ -104,9 +112,18 @@ struct svc_dg_xprt {
  * Replaces old struct x_vc_data by locally wrapping struct rpc_dplx_rec,
  * which wraps struct svc_xprt indexed by fd.
  */
+struct svc_ioq_blocked;
+
 struct svc_vc_xprt {
 	struct rpc_dplx_rec sx_dr;	/* SVCXPRT indexed by fd */
 	int32_t sx_fbtbc;		/* fragment bytes to be consumed */
+	char *sx_rbuf;			/* SVC_FLAG_VC_DRAIN staging buffer */
+	u_int sx_rsize;			/* staging buffer size */
+	u_int sx_rlen;			/* staged bytes (partial header) */
+	struct poolq_head sx_zcq;	/* MSG_ZEROCOPY sends not completed */
+	uint32_t sx_zcseq;		/* next MSG_ZEROCOPY send id */
+	int sx_zerocopy;		/* 0: untried, < 0: unavailable */
+	struct svc_ioq_blocked *sx_blocked; /* output waiting for POLLOUT */
 };
 #define VC_DR(p) (opr_containerof((p), struct svc_vc_xprt, sx_dr))
 
@@ -142,10 +159,16 @@ svc_override_ops(struct xp_ops *ops, SVCXPRT *rendezvous)
 	}
 }
 
+/* in rpc_cksum.c */
+void svc_cksum(struct svc_req *, void *, size_t);
+
 /* in svc_rqst.c */
 int svc_rqst_rearm_events(SVCXPRT *);
+int svc_rqst_output_events(SVCXPRT *);
+struct work_pool *svc_rqst_work_pool(SVCXPRT *);
 int svc_rqst_xprt_register(SVCXPRT *, SVCXPRT *);
 void svc_rqst_xprt_unregister(SVCXPRT *, uint32_t);
 void svc_rqst_unhook(SVCXPRT *);
+int svc_rqst_delete_evchan(uint32_t);
 
 #endif				/* TIRPC_SVC_INTERNAL_H */
@@ -37,6 +37,7 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <linux/errqueue.h>
 
 #include <assert.h>
 #include <err.h>
@@ -71,114 +72,654 @@
 #define LAST_FRAG ((u_int32_t)(1 << 31))
 #define MAXALLOCA (256)
 
-static inline int
-svc_ioq_flushv(SVCXPRT *xprt, struct xdr_ioq *xioq)
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define SVC_IOQ_ZEROCOPY 1
+#endif
+#define SVC_IOQ_ZEROCOPY_MIN (16 * 1024)	/* smaller are copied */
+
+/*
+ * Replies sent with MSG_ZEROCOPY, held until the kernel reports
+ * completion of send id zc_seq on the socket error queue.
+ */
+struct svc_ioq_zc {
+	struct poolq_entry zc_q;
+	struct poolq_head_s zc_ioqs;
+	uint32_t zc_seq;
+	u_int zc_size;
+	u_int32_t zc_headers[];	/* fragment headers */
+};
+
+static void
+svc_ioq_zc_free(struct svc_ioq_zc *zc)
 {
-	struct iovec *iov, *tiov, *wiov;
 	struct poolq_entry *have;
-	struct xdr_ioq_uv *data;
-	ssize_t result;
-	u_int32_t frag_header;
-	u_int32_t fbytes;
-	u_int32_t remaining = 0;
-	u_int32_t vsize = (xioq->ioq_uv.uvqh.qcount + 1) * sizeof(struct iovec);
-	int iw = 0;
-	int ix = 1;
-	int rc = 0;
 
-	if (unlikely(vsize > MAXALLOCA)) {
-		iov = mem_alloc(vsize);
-	} else {
-		iov = alloca(vsize);
+	while ((have = TAILQ_FIRST(&zc->zc_ioqs))) {
+		TAILQ_REMOVE(&zc->zc_ioqs, have, q);
+		XDR_DESTROY(_IOQ(have)->xdrs);
 	}
-	wiov = iov; /* position at initial fragment header */
-
-	/* update the most recent data length, just in case */
-	xdr_tail_update(xioq->xdrs);
-
-	/* build list after initial fragment header (ix = 1 above) */
-	TAILQ_FOREACH(have, &(xioq->ioq_uv.uvqh.qh), q) {
-		data = IOQ_(have);
-		tiov = iov + ix;
-		tiov->iov_base = data->v.vio_head;
-		tiov->iov_len = ioquv_length(data);
-		remaining += tiov->iov_len;
-		ix++;
+	mem_free(zc, zc->zc_size);
+}
+
+static inline bool
+svc_ioq_zerocopy_enable(SVCXPRT *xprt, struct svc_vc_xprt *xd)
+{
+#ifdef SVC_IOQ_ZEROCOPY
+	int one = 1;
+
+	if (likely(xd->sx_zerocopy))
+		return (xd->sx_zerocopy > 0);
+
+	if (setsockopt(xprt->xp_fd, SOL_SOCKET, SO_ZEROCOPY,
+		       &one, sizeof(one))) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: %p fd %d SO_ZEROCOPY failed (%d), copying",
+			__func__, xprt, xprt->xp_fd, errno);
+		xd->sx_zerocopy = -1;
+		return (false);
 	}
+	xd->sx_zerocopy = 1;
+	return (true);
+#else
+	return (false);
+#endif
+}
 
-	while (remaining > 0) {
-		if (iw == 0) {
-			/* new fragment header, determine last iov */
-			fbytes = 0;
-			for (tiov = &wiov[++iw];
-			     (tiov < &iov[ix]) && (iw < __svc_maxiov);
-			     ++tiov, ++iw) {
-				fbytes += tiov->iov_len;
-
-				/* check for fragment value overflow */
-				/* never happens, see ganesha FSAL_MAXIOSIZE */
-				if (unlikely(fbytes >= LAST_FRAG)) {
-					fbytes -= tiov->iov_len;
+/*
+ * Release replies whose MSG_ZEROCOPY sends have completed.
+ */
+void
+svc_ioq_zerocopy_reap(SVCXPRT *xprt)
+{
+#ifdef SVC_IOQ_ZEROCOPY
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct sock_extended_err *serr;
+	struct poolq_entry *have;
+	struct svc_ioq_zc *zc;
+	struct cmsghdr *cm;
+	struct msghdr msg;
+	char control[CMSG_SPACE(sizeof(*serr) + sizeof(struct sockaddr_in6))];
+
+	mutex_lock(&xd->sx_zcq.qmutex);
+	while (xd->sx_zcq.qcount > 0) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(xprt->xp_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!(cm->cmsg_level == SOL_IP
+			      && cm->cmsg_type == IP_RECVERR)
+			 && !(cm->cmsg_level == SOL_IPV6
+			      && cm->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			serr = (struct sock_extended_err *)CMSG_DATA(cm);
+			if (serr->ee_errno
+			 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+
+			/* in order for TCP, ee_data is the last completed */
+			while ((have = TAILQ_FIRST(&xd->sx_zcq.qh))) {
+				zc = opr_containerof(have, struct svc_ioq_zc,
+						     zc_q);
+				if ((int32_t)(zc->zc_seq - serr->ee_data) > 0)
 					break;
-				}
-			} /* for */
-
-			/* fragment length doesn't include fragment header */
-			if (&wiov[iw] < &iov[ix]) {
-				frag_header = htonl((u_int32_t) (fbytes));
-			} else {
-				frag_header = htonl((u_int32_t) (fbytes | LAST_FRAG));
+				TAILQ_REMOVE(&xd->sx_zcq.qh, have, q);
+				(xd->sx_zcq.qcount)--;
+				svc_ioq_zc_free(zc);
 			}
-			wiov->iov_base = &(frag_header);
-			wiov->iov_len = sizeof(u_int32_t);
-
-			/* writev return includes fragment header */
-			remaining += sizeof(u_int32_t);
-			fbytes += sizeof(u_int32_t);
 		}
+	}
+	mutex_unlock(&xd->sx_zcq.qmutex);
+#endif
+}
 
-		/* blocking write */
-		result = writev(xprt->xp_fd, wiov, iw);
-		remaining -= result;
+/*
+ * Release all pending replies, when the transport is freed.  The kernel
+ * holds its own page references for any still in flight.
+ */
+void
+svc_ioq_zerocopy_destroy(struct poolq_head *zcq)
+{
+	struct poolq_entry *have;
+
+	while ((have = TAILQ_FIRST(&zcq->qh))) {
+		TAILQ_REMOVE(&zcq->qh, have, q);
+		(zcq->qcount)--;
+		svc_ioq_zc_free(opr_containerof(have, struct svc_ioq_zc,
+						zc_q));
+	}
+	poolq_head_destroy(zcq);
+}
+
+static inline void
+svc_ioq_zerocopy_add(SVCXPRT *xprt, struct svc_ioq_zc *zc)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
 
-		if (result == fbytes) {
-			wiov += iw - 1;
-			iw = 0;
+	mutex_lock(&xd->sx_zcq.qmutex);
+	TAILQ_INSERT_TAIL(&xd->sx_zcq.qh, &zc->zc_q, q);
+	(xd->sx_zcq.qcount)++;
+	mutex_unlock(&xd->sx_zcq.qmutex);
+
+	/* completions usually also wake the transport; do not wait */
+	svc_ioq_zerocopy_reap(xprt);
+}
+
+/*
+ * Queued output budgets (ioq_sendq_budget, ioq_sendq_global).  Over
+ * budget, svc_rqst_rearm_events() stops polling the transport for input,
+ * and it waits on svc_ioq_paused until output drains to half the budget.
+ */
+static struct poolq_head svc_ioq_paused = {
+	.qh = TAILQ_HEAD_INITIALIZER(svc_ioq_paused.qh),
+	.qmutex = PTHREAD_MUTEX_INITIALIZER,
+};
+static uint64_t svc_ioq_sendq_bytes;	/* all transports */
+static uint64_t svc_ioq_sendq_drops;
+static uint64_t svc_ioq_sendq_pauses;
+
+#define SVC_IOQ_DROP(budget) ((budget) * 2)
+#define SVC_IOQ_RESUME(budget) ((budget) / 2)
+
+static inline bool
+svc_ioq_over(struct rpc_dplx_rec *rec, uint64_t bytes, uint64_t budget,
+	     uint64_t global)
+{
+	return ((__svc_params->ioq.sendq_budget
+		 && atomic_fetch_uint64_t(&rec->sendq_bytes) + bytes > budget)
+	     || (__svc_params->ioq.sendq_global
+		 && atomic_fetch_uint64_t(&svc_ioq_sendq_bytes) + bytes
+		    > global));
+}
+
+static inline void
+svc_ioq_sendq_add(SVCXPRT *xprt, uint64_t bytes)
+{
+	atomic_add_uint64_t(&REC_XPRT(xprt)->sendq_bytes, bytes);
+	atomic_add_uint64_t(&svc_ioq_sendq_bytes, bytes);
+}
+
+/*
+ * Over budget, pause receiving (not locked).  Returns true while paused.
+ */
+bool
+svc_ioq_pause(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+
+	if (likely(!svc_ioq_over(rec, 0, __svc_params->ioq.sendq_budget,
+				 __svc_params->ioq.sendq_global)))
+		return (false);
+
+	mutex_lock(&svc_ioq_paused.qmutex);
+	if (xprt->xp_flags & SVC_XPRT_FLAG_PAUSED) {
+		mutex_unlock(&svc_ioq_paused.qmutex);
+		return (true);
+	}
+
+	/* flag before checking again, see svc_ioq_sendq_sub() */
+	atomic_set_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_PAUSED);
+	if (!svc_ioq_over(rec, 0, __svc_params->ioq.sendq_budget,
+			  __svc_params->ioq.sendq_global)) {
+		atomic_clear_uint16_t_bits(&xprt->xp_flags,
+					   SVC_XPRT_FLAG_PAUSED);
+		mutex_unlock(&svc_ioq_paused.qmutex);
+		return (false);
+	}
+
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+	TAILQ_INSERT_TAIL(&svc_ioq_paused.qh, &rec->sendq_paused, q);
+	(svc_ioq_paused.qcount)++;
+	mutex_unlock(&svc_ioq_paused.qmutex);
+
+	atomic_inc_uint64_t(&svc_ioq_sendq_pauses);
+	__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+		"%s: %p fd %d paused, %" PRIu64 " bytes queued",
+		__func__, xprt, xprt->xp_fd, rec->sendq_bytes);
+	return (true);
+}
+
+/*
+ * Output drained, resume receiving on paused transports now under half
+ * their budget.  Only this transport, unless the global budget was
+ * crossed.
+ */
+static void
+svc_ioq_sendq_sub(SVCXPRT *xprt, uint64_t bytes)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct poolq_head_s ready;
+	struct poolq_entry *have;
+	struct poolq_entry *next;
+	uint64_t global = __svc_params->ioq.sendq_global;
+	uint64_t total;
+	bool all;
+
+	atomic_sub_uint64_t(&rec->sendq_bytes, bytes);
+	total = atomic_sub_uint64_t(&svc_ioq_sendq_bytes, bytes);
+
+	all = global && total <= SVC_IOQ_RESUME(global)
+	   && total + bytes > SVC_IOQ_RESUME(global);
+	if (likely(!all
+		   && !(atomic_fetch_uint16_t(&xprt->xp_flags)
+			& SVC_XPRT_FLAG_PAUSED)))
+		return;
+
+	TAILQ_INIT(&ready);
+	mutex_lock(&svc_ioq_paused.qmutex);
+	TAILQ_FOREACH_SAFE(have, &svc_ioq_paused.qh, q, next) {
+		rec = opr_containerof(have, struct rpc_dplx_rec, sendq_paused);
+
+		if (!all && &rec->xprt != xprt)
+			continue;
+		if (svc_ioq_over(rec, 0,
+				 SVC_IOQ_RESUME(__svc_params->ioq.sendq_budget),
+				 SVC_IOQ_RESUME(global)))
 			continue;
+
+		TAILQ_REMOVE(&svc_ioq_paused.qh, have, q);
+		(svc_ioq_paused.qcount)--;
+		atomic_clear_uint16_t_bits(&rec->xprt.xp_flags,
+					   SVC_XPRT_FLAG_PAUSED);
+		TAILQ_INSERT_TAIL(&ready, have, q);
+	}
+	mutex_unlock(&svc_ioq_paused.qmutex);
+
+	while ((have = TAILQ_FIRST(&ready))) {
+		TAILQ_REMOVE(&ready, have, q);
+		rec = opr_containerof(have, struct rpc_dplx_rec, sendq_paused);
+
+		if (unlikely(svc_rqst_rearm_events(&rec->xprt))) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+				__func__, &rec->xprt, rec->xprt.xp_fd);
+			SVC_DESTROY(&rec->xprt);
 		}
+		SVC_RELEASE(&rec->xprt, SVC_RELEASE_FLAG_NONE);
+	}
+}
+
+/*
+ * Stop waiting for output to drain, when the transport is unlinked.
+ */
+static void
+svc_ioq_unpause(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+
+	mutex_lock(&svc_ioq_paused.qmutex);
+	if (!(xprt->xp_flags & SVC_XPRT_FLAG_PAUSED)) {
+		mutex_unlock(&svc_ioq_paused.qmutex);
+		return;
+	}
+	TAILQ_REMOVE(&svc_ioq_paused.qh, &rec->sendq_paused, q);
+	(svc_ioq_paused.qcount)--;
+	atomic_clear_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_PAUSED);
+	mutex_unlock(&svc_ioq_paused.qmutex);
+
+	SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+}
+
+void
+svc_sendq_get_stats(struct svc_sendq_stats *stats)
+{
+	stats->bytes = atomic_fetch_uint64_t(&svc_ioq_sendq_bytes);
+	stats->drops = atomic_fetch_uint64_t(&svc_ioq_sendq_drops);
+	stats->pauses = atomic_fetch_uint64_t(&svc_ioq_sendq_pauses);
+}
+
+/*
+ * Vector of a batch being written.
+ */
+struct svc_ioq_vec {
+	struct iovec *wiov;		/* next to write */
+	struct svc_ioq_zc *zc;		/* MSG_ZEROCOPY record, or NULL */
+	size_t remaining;		/* bytes to write */
+	int iw;				/* vectors to write */
+	bool zerocopy;			/* zc was sent */
+	bool nonblock;			/* SVC_FLAG_NONBLOCK_OUT */
+};
+
+/*
+ * Batch parked on the transport while the socket buffer is full, until
+ * POLLOUT (SVC_FLAG_NONBLOCK_OUT).
+ */
+struct svc_ioq_blocked {
+	struct poolq_head_s ioqs;	/* replies being written */
+	struct svc_ioq_vec v;
+	u_int size;
+	struct iovec iov[];		/* then fragment headers */
+};
+
+static inline ssize_t
+svc_ioq_sendmsg(int fd, struct msghdr *msg, int flags)
+{
+	if (!flags) {
+		/* blocking write */
+		return writev(fd, msg->msg_iov, msg->msg_iovlen);
+	}
+	return sendmsg(fd, msg, flags);
+}
+
+/*
+ * Write the vector, in chunks of __svc_maxiov.  Returns 1 when the write
+ * would block (nonblock only).
+ */
+static int
+svc_ioq_sendv(SVCXPRT *xprt, struct svc_ioq_vec *v)
+{
+	struct msghdr msg;
+	ssize_t result;
+	int flags = v->nonblock ? MSG_DONTWAIT : 0;
+
+	memset(&msg, 0, sizeof(msg));
+
+	while (v->remaining > 0) {
+		msg.msg_iov = v->wiov;
+		msg.msg_iovlen = MIN(v->iw, __svc_maxiov);
+#ifdef SVC_IOQ_ZEROCOPY
+		if (v->zc) {
+			result = sendmsg(xprt->xp_fd, &msg, flags | MSG_ZEROCOPY);
+			if (result > 0) {
+				v->zc->zc_seq = (VC_DR(REC_XPRT(xprt))->sx_zcseq)++;
+				v->zerocopy = true;
+			} else if (result < 0 && errno == ENOBUFS) {
+				/* out of option memory, copy instead */
+				result = svc_ioq_sendmsg(xprt->xp_fd, &msg,
+							 flags);
+			}
+		} else
+#endif
+		result = svc_ioq_sendmsg(xprt->xp_fd, &msg, flags);
+
 		if (unlikely(result < 0)) {
+			if (flags && (errno == EAGAIN || errno == EWOULDBLOCK))
+				return (1);
+
 			__warnx(TIRPC_DEBUG_FLAG_ERROR,
 				"%s() writev failed (%d)\n",
 				__func__, errno);
-			rc = -1;
-			break;
+			return (-1);
+		}
+		v->remaining -= result;
+
+		/* writev underrun (or more than __svc_maxiov) */
+		while (v->iw > 0 && v->wiov->iov_len <= result) {
+			result -= v->wiov->iov_len;
+			++(v->wiov);
+			--(v->iw);
+		}
+		if (result > 0) {
+			v->wiov->iov_len -= result;
+			v->wiov->iov_base += result;
 		}
-		fbytes -= result;
-
-		/* rare? writev underrun? (assume never overrun) */
-		for (tiov = wiov; iw > 0; ++tiov, --iw) {
-			if (tiov->iov_len > result) {
-				tiov->iov_len -= result;
-				tiov->iov_base += result;
-				wiov = tiov;
-				break;
-			} else {
-				result -= tiov->iov_len;
-			}
-		} /* for */
 	} /* while */
 
+	return (0);
+}
+
+/*
+ * Wait for POLLOUT, then svc_ioq_write_resume() continues.  Returns 1 when
+ * parked; otherwise writes the rest blocking, as if nonblock were unset.
+ */
+static int
+svc_ioq_park(SVCXPRT *xprt, struct svc_ioq_blocked *wb)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct poolq_head *ifph = &xprt->sendq;
+
+	mutex_lock(&ifph->qmutex);
+	xd->sx_blocked = wb;
+	mutex_unlock(&ifph->qmutex);
+
+	if (likely(!svc_rqst_output_events(xprt)))
+		return (1);
+
+	mutex_lock(&ifph->qmutex);
+	if (xd->sx_blocked != wb) {
+		/* already resumed (or aborted) */
+		mutex_unlock(&ifph->qmutex);
+		return (1);
+	}
+	xd->sx_blocked = NULL;
+	mutex_unlock(&ifph->qmutex);
+
+	wb->v.nonblock = false;
+	return (svc_ioq_sendv(xprt, &wb->v));
+}
+
+/*
+ * Move the batch and the rest of its vector into the transport, copying
+ * fragment headers not held by the MSG_ZEROCOPY record.
+ */
+static int
+svc_ioq_block(SVCXPRT *xprt, struct poolq_head_s *batch,
+	      struct svc_ioq_vec *v, u_int32_t *headers, u_int vmax)
+{
+	struct svc_ioq_blocked *wb;
+	u_int32_t *wheaders;
+	u_int hsize = v->zc ? 0 : vmax * sizeof(u_int32_t);
+	u_int size = sizeof(*wb) + v->iw * sizeof(struct iovec) + hsize;
+	int ix;
+	int rc;
+
+	wb = mem_alloc(size);
+	wb->size = size;
+	wb->v = *v;
+	wb->v.wiov = wb->iov;
+	memcpy(wb->iov, v->wiov, v->iw * sizeof(struct iovec));
+
+	if (hsize) {
+		wheaders = (u_int32_t *)(wb->iov + v->iw);
+		memcpy(wheaders, headers, hsize);
+
+		for (ix = 0; ix < v->iw; ix++) {
+			char *base = wb->iov[ix].iov_base;
+
+			if (base >= (char *)headers
+			 && base < (char *)headers + hsize)
+				wb->iov[ix].iov_base = (char *)wheaders
+						     + (base - (char *)headers);
+		}
+	}
+
+	TAILQ_INIT(&wb->ioqs);
+	TAILQ_SWAP(&wb->ioqs, batch, poolq_entry, q);
+
+	rc = svc_ioq_park(xprt, wb);
+	if (rc > 0)
+		return (rc);
+
+	/* written here after all */
+	TAILQ_SWAP(&wb->ioqs, batch, poolq_entry, q);
+	*v = wb->v;
+	mem_free(wb, wb->size);
+	return (rc);
+}
+
+/*
+ * Write a batch of replies, each one or more record fragments, with as
+ * few writev() as __svc_maxiov allows.  count is the number of buffers
+ * in the batch, plus one for each reply.
+ *
+ * Large batches are sent with MSG_ZEROCOPY (SVC_FLAG_ZEROCOPY), then
+ * are returned in v->zc to be held until completion.
+ *
+ * Returns 1 when the batch was parked (SVC_FLAG_NONBLOCK_OUT).
+ */
+static inline int
+svc_ioq_flushv(SVCXPRT *xprt, struct poolq_head_s *batch, u_int count,
+	       size_t bytes, struct svc_ioq_vec *v)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct svc_ioq_zc *zc = NULL;
+	struct iovec *iov, *hiov;
+	struct poolq_entry *have;
+	struct poolq_entry *uvq;
+	struct xdr_ioq_uv *data;
+	u_int32_t *headers;
+	size_t remaining = 0;
+	size_t len;
+	u_int32_t fbytes;
+	/* each buffer may begin a fragment (never happens) */
+	u_int vmax = 2 * count;
+	u_int32_t vsize = vmax * (sizeof(struct iovec) + sizeof(u_int32_t));
+	int ih = 0;
+	int ix = 0;
+	int rc;
+
 	if (unlikely(vsize > MAXALLOCA)) {
-		mem_free(iov, vsize);
+		iov = mem_alloc(vsize);
+	} else {
+		iov = alloca(vsize);
+	}
+	headers = (u_int32_t *)(iov + vmax);
+
+	if ((__svc_params->flags & SVC_FLAG_ZEROCOPY)
+	 && bytes >= SVC_IOQ_ZEROCOPY_MIN
+	 && svc_ioq_zerocopy_enable(xprt, xd)) {
+		/* headers must outlast the send */
+		zc = mem_alloc(sizeof(*zc) + vmax * sizeof(u_int32_t));
+		zc->zc_size = sizeof(*zc) + vmax * sizeof(u_int32_t);
+		TAILQ_INIT(&zc->zc_ioqs);
+		headers = zc->zc_headers;
+	}
+
+	TAILQ_FOREACH(have, batch, q) {
+		struct xdr_ioq *xioq = _IOQ(have);
+
+		/* update the most recent data length, just in case */
+		xdr_tail_update(xioq->xdrs);
+
+		/* fragment header, filled in below */
+		hiov = &iov[ix++];
+		fbytes = 0;
+
+		TAILQ_FOREACH(uvq, &xioq->ioq_uv.uvqh.qh, q) {
+			data = IOQ_(uvq);
+			len = ioquv_length(data);
+
+			/* check for fragment value overflow */
+			/* never happens, see ganesha FSAL_MAXIOSIZE */
+			if (unlikely(fbytes && fbytes + len >= LAST_FRAG)) {
+				headers[ih] = htonl(fbytes);
+				hiov->iov_base = &headers[ih++];
+				hiov->iov_len = sizeof(u_int32_t);
+				remaining += sizeof(u_int32_t) + fbytes;
+
+				hiov = &iov[ix++];
+				fbytes = 0;
+			}
+			iov[ix].iov_base = data->v.vio_head;
+			iov[ix].iov_len = len;
+			fbytes += len;
+			ix++;
+		}
+
+		/* fragment length doesn't include fragment header */
+		headers[ih] = htonl(fbytes | LAST_FRAG);
+		hiov->iov_base = &headers[ih++];
+		hiov->iov_len = sizeof(u_int32_t);
+		remaining += sizeof(u_int32_t) + fbytes;
 	}
 
+	v->wiov = iov;
+	v->zc = zc;
+	v->remaining = remaining;
+	v->iw = ix;
+	v->zerocopy = false;
+	/* without an event channel, nothing would resume */
+	v->nonblock = (__svc_params->flags & SVC_FLAG_NONBLOCK_OUT)
+		      && REC_XPRT(xprt)->ev_p;
+
+	rc = svc_ioq_sendv(xprt, v);
+	if (rc > 0)
+		rc = svc_ioq_block(xprt, batch, v, (u_int32_t *)(iov + vmax),
+				   vmax);
+
+	if (unlikely(vsize > MAXALLOCA)) {
+		mem_free(iov, vsize);
+	}
 	return rc;
 }
 
+/*
+ * Release a written batch, returning the number of replies.
+ */
+static int
+svc_ioq_done(SVCXPRT *xprt, struct poolq_head_s *batch,
+	     struct svc_ioq_vec *v, int rc)
+{
+	struct svc_ioq_zc *zc = v->zc;
+	struct poolq_entry *have;
+	uint64_t bytes = 0;
+	int n = 0;
+
+	if (zc && !v->zerocopy) {
+		mem_free(zc, zc->zc_size);
+		zc = NULL;
+	}
+
+	while ((have = TAILQ_FIRST(batch))) {
+		struct xdr_ioq *xioq = _IOQ(have);
+
+		TAILQ_REMOVE(batch, have, q);
+		bytes += XDR_GETPOS(xioq->xdrs);
+
+		if (rc < 0) {
+			/* IO failed, destroy rather than releasing */
+			SVC_DESTROY(xprt);
+			rc = 0;
+		} else {
+			SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		}
+
+		if (zc)
+			TAILQ_INSERT_TAIL(&zc->zc_ioqs, have, q);
+		else
+			XDR_DESTROY(xioq->xdrs);
+		n++;
+	}
+
+	if (zc)
+		svc_ioq_zerocopy_add(xprt, zc);
+
+	svc_ioq_sendq_sub(xprt, bytes);
+	return (n);
+}
+
+/*
+ * Account for n written replies, then dequeue the next, if any.
+ */
+static inline struct xdr_ioq *
+svc_ioq_next(struct poolq_head *ifph, int n)
+{
+	struct poolq_entry *have;
+
+	mutex_lock(&ifph->qmutex);
+	ifph->qcount -= n;
+	if (ifph->qcount == 0) {
+		mutex_unlock(&ifph->qmutex);
+		return (NULL);
+	}
+
+	have = TAILQ_FIRST(&ifph->qh);
+	TAILQ_REMOVE(&ifph->qh, have, q);
+	mutex_unlock(&ifph->qmutex);
+
+	return (_IOQ(have));
+}
+
 static void
 svc_ioq_write(SVCXPRT *xprt, struct xdr_ioq *xioq, struct poolq_head *ifph)
 {
+	struct poolq_head_s batch;
 	struct poolq_entry *have;
+	int n;
 
 	/* ifph is part of xprt, so make sure you don't access
 	 * ifph after releasing xprt! ifph can be removed as the
@@ -188,38 +729,136 @@ svc_ioq_write(SVCXPRT *xprt, struct xdr_ioq *xioq, struct poolq_head *ifph)
 	 * of this function.
 	 */
 	SVC_REF(xprt, SVC_REF_FLAG_NONE);
-	for (;;) {
+	do {
+		struct svc_ioq_vec v = {
+			.zc = NULL,
+			.zerocopy = false,
+		};
+		size_t bytes = XDR_GETPOS(xioq->xdrs);
+		u_int count = xioq->ioq_uv.uvqh.qcount + 1;
 		int rc = 0;
 
+		n = 1;
+		TAILQ_INIT(&batch);
+		TAILQ_INSERT_TAIL(&batch, &xioq->ioq_s, q);
+
+		/* coalesce queued output, up to __svc_maxiov */
+		mutex_lock(&ifph->qmutex);
+		while ((have = TAILQ_FIRST(&ifph->qh))) {
+			struct xdr_ioq *next = _IOQ(have);
+
+			if (count + next->ioq_uv.uvqh.qcount + 1
+			    > __svc_maxiov)
+				break;
+
+			TAILQ_REMOVE(&ifph->qh, have, q);
+			TAILQ_INSERT_TAIL(&batch, have, q);
+			count += next->ioq_uv.uvqh.qcount + 1;
+			bytes += XDR_GETPOS(next->xdrs);
+			n++;
+		}
+		mutex_unlock(&ifph->qmutex);
+
 		/* do i/o unlocked */
 		if (svc_work_pool.params.thrd_max
 		 && !(xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)) {
 			/* all systems are go! */
-			rc = svc_ioq_flushv(xprt, xioq);
+			rc = svc_ioq_flushv(xprt, &batch, count, bytes, &v);
 		}
 
-		if (rc < 0) {
-			/* IO failed, destroy rather than releasing */
-			SVC_DESTROY(xprt);
-		} else {
+		if (rc > 0) {
+			/* parked, with the rest of the queue */
 			SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+			return;
 		}
 
-		XDR_DESTROY(xioq->xdrs);
+		n = svc_ioq_done(xprt, &batch, &v, rc);
+	} while ((xioq = svc_ioq_next(ifph, n)));
 
-		mutex_lock(&ifph->qmutex);
-		if (--(ifph->qcount) == 0)
-			break;
+	SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+}
 
-		have = TAILQ_FIRST(&ifph->qh);
-		TAILQ_REMOVE(&ifph->qh, have, q);
+/*
+ * POLLOUT after output was parked, in the transport task.  Continues
+ * with output queued meanwhile.
+ */
+void
+svc_ioq_write_resume(SVCXPRT *xprt)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct poolq_head *ifph = &xprt->sendq;
+	struct svc_ioq_blocked *wb;
+	struct xdr_ioq *xioq;
+	int rc = 0;
+
+	mutex_lock(&ifph->qmutex);
+	wb = xd->sx_blocked;
+	xd->sx_blocked = NULL;
+	atomic_clear_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_BLOCKED);
+	mutex_unlock(&ifph->qmutex);
+
+	if (!wb)
+		return;
+
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+	if (svc_work_pool.params.thrd_max
+	 && !(xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)) {
+		rc = svc_ioq_sendv(xprt, &wb->v);
+		if (rc > 0)
+			rc = svc_ioq_park(xprt, wb);
+	}
+
+	if (rc > 0) {
+		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		return;
+	}
+
+	xioq = svc_ioq_next(ifph, svc_ioq_done(xprt, &wb->ioqs, &wb->v, rc));
+	mem_free(wb, wb->size);
+
+	if (xioq)
+		svc_ioq_write(xprt, xioq, ifph);
+	SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+}
+
+/*
+ * Release parked and queued output, when the transport is unlinked.
+ */
+void
+svc_ioq_write_abort(SVCXPRT *xprt)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct poolq_head *ifph = &xprt->sendq;
+	struct svc_ioq_blocked *wb;
+	struct poolq_entry *have;
+	uint64_t bytes = 0;
+
+	svc_ioq_unpause(xprt);
+
+	mutex_lock(&ifph->qmutex);
+	wb = xd->sx_blocked;
+	xd->sx_blocked = NULL;
+	atomic_clear_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_BLOCKED);
+
+	if (!wb) {
+		/* any writer will discard the queue */
 		mutex_unlock(&ifph->qmutex);
+		return;
+	}
 
-		xioq = _IOQ(have);
-		xprt = (SVCXPRT *)xioq->xdrs[0].x_lib[1];
+	/* the writer is parked, so take its place */
+	while ((have = TAILQ_FIRST(&ifph->qh))) {
+		TAILQ_REMOVE(&ifph->qh, have, q);
+		bytes += XDR_GETPOS(_IOQ(have)->xdrs);
+		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		XDR_DESTROY(_IOQ(have)->xdrs);
 	}
+	ifph->qcount = 0;
 	mutex_unlock(&ifph->qmutex);
-	SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+
+	(void)svc_ioq_done(xprt, &wb->ioqs, &wb->v, 0);
+	mem_free(wb, wb->size);
+	svc_ioq_sendq_sub(xprt, bytes);
 }
 
 static void
@@ -260,44 +899,66 @@ static void store_sockip(struct sockaddr_storage *addr, char *buf, int len)
 }
 
 static time_t last_time;
-void
-svc_ioq_write_now(SVCXPRT *xprt, struct xdr_ioq *xioq)
+
+/*
+ * Queue output behind the current writer, if any.  Returns true when the
+ * caller is the writer.
+ */
+static inline bool
+svc_ioq_enqueue(SVCXPRT *xprt, struct xdr_ioq *xioq, struct poolq_head *ifph)
 {
-	struct poolq_head *ifph = &xprt->sendq;
 	char ipaddr[INET6_ADDRSTRLEN];
+	uint64_t bytes = XDR_GETPOS(xioq->xdrs);
 	time_t ctime;
 
 	SVC_REF(xprt, SVC_REF_FLAG_NONE);
 	mutex_lock(&ifph->qmutex);
 
-	if ((ifph->qcount)++ > 0) {
-		/* If too many responses in the queue, drop them to
-		 * avoid consuming too much memory.  Constant 2K here is
-		 * ok for now, but ideally it should be configurable!
-		 */
-		if (unlikely(ifph->qcount > 2000)) {
-			SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
-			XDR_DESTROY(xioq->xdrs);
-			--(ifph->qcount);
-			ctime = time(NULL);
-			if (ctime > last_time + 30) { /* More than 30 seconds */
-				last_time = ctime;
-				store_sockip(&xprt->xp_remote.ss, ipaddr,
-					     sizeof(ipaddr));
-				syslog(LOG_ERR,
-				       "nfs-ganesha: NFS client %s is slow, "
-				       "resetting socket 0x%p", ipaddr, xprt);
-			}
-			mutex_unlock(&ifph->qmutex);
-			return;
-		}
+	if ((ifph->qcount)++ == 0) {
+		svc_ioq_sendq_add(xprt, bytes);
+		mutex_unlock(&ifph->qmutex);
+		return (true);
+	}
 
-		/* queue additional output requests without task switch */
-		TAILQ_INSERT_TAIL(&ifph->qh, &(xioq->ioq_s), q);
+	/* If too much output is queued, drop it to avoid consuming too
+	 * much memory.  Receiving paused at half this, so the client is
+	 * not reading its replies.
+	 */
+	if (unlikely(svc_ioq_over(REC_XPRT(xprt), bytes,
+				  SVC_IOQ_DROP(__svc_params->ioq.sendq_budget),
+				  SVC_IOQ_DROP(__svc_params->ioq.sendq_global)))) {
+		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		XDR_DESTROY(xioq->xdrs);
+		--(ifph->qcount);
+		atomic_inc_uint64_t(&svc_ioq_sendq_drops);
+		ctime = time(NULL);
+		if (ctime > last_time + 30) { /* More than 30 seconds */
+			last_time = ctime;
+			store_sockip(&xprt->xp_remote.ss, ipaddr,
+				     sizeof(ipaddr));
+			syslog(LOG_ERR,
+			       "nfs-ganesha: NFS client %s is slow, "
+			       "resetting socket 0x%p", ipaddr, xprt);
+		}
 		mutex_unlock(&ifph->qmutex);
-		return;
+		return (false);
 	}
+
+	/* accounted before the writer can dequeue it */
+	svc_ioq_sendq_add(xprt, bytes);
+	TAILQ_INSERT_TAIL(&ifph->qh, &(xioq->ioq_s), q);
 	mutex_unlock(&ifph->qmutex);
+	return (false);
+}
+
+void
+svc_ioq_write_now(SVCXPRT *xprt, struct xdr_ioq *xioq)
+{
+	struct poolq_head *ifph = &xprt->sendq;
+
+	/* queue additional output requests without task switch */
+	if (!svc_ioq_enqueue(xprt, xioq, ifph))
+		return;
 
 	/* handle this output request without queuing, then any additional
 	 * output requests without a task switch (using this thread).
@@ -316,43 +977,13 @@ void
 svc_ioq_write_submit(SVCXPRT *xprt, struct xdr_ioq *xioq)
 {
 	struct poolq_head *ifph = &xprt->sendq;
-	char ipaddr[INET6_ADDRSTRLEN];
-	time_t ctime;
 
-	SVC_REF(xprt, SVC_REF_FLAG_NONE);
-	mutex_lock(&ifph->qmutex);
-
-	if ((ifph->qcount)++ > 0) {
-		/* If too many responses in the queue, drop them to
-		 * avoid consuming too much memory.  Constant 2K here is
-		 * ok for now, but ideally it should be configurable!
-		 */
-		if (unlikely(ifph->qcount > 2000)) {
-			SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
-			XDR_DESTROY(xioq->xdrs);
-			--(ifph->qcount);
-			ctime = time(NULL);
-			if (ctime > last_time + 30) { /* More than 30 seconds */
-				last_time = ctime;
-				store_sockip(&xprt->xp_remote.ss, ipaddr,
-					     sizeof(ipaddr));
-				syslog(LOG_ERR,
-				       "nfs-ganesha: NFS client %s is slow, "
-				       "resetting socket 0x%p", ipaddr, xprt);
-			}
-			mutex_unlock(&ifph->qmutex);
-			return;
-		}
-
-		/* queue additional output requests, they will be handled by
-		 * existing thread without another task switch.
-		 */
-		TAILQ_INSERT_TAIL(&ifph->qh, &(xioq->ioq_s), q);
-		mutex_unlock(&ifph->qmutex);
+	/* queue additional output requests, they will be handled by
+	 * existing thread without another task switch.
+	 */
+	if (!svc_ioq_enqueue(xprt, xioq, ifph))
 		return;
-	}
-	mutex_unlock(&ifph->qmutex);
 
 	xioq->ioq_wpe.fun = svc_ioq_write_callback;
-	work_pool_submit(&svc_work_pool, &xioq->ioq_wpe);
+	work_pool_submit(svc_rqst_work_pool(xprt), &xioq->ioq_wpe);
 }
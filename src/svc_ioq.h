@@ -31,5 +31,10 @@
 
 void svc_ioq_write_now(SVCXPRT *, struct xdr_ioq *);
 void svc_ioq_write_submit(SVCXPRT *, struct xdr_ioq *);
+void svc_ioq_write_resume(SVCXPRT *);
+void svc_ioq_write_abort(SVCXPRT *);
+bool svc_ioq_pause(SVCXPRT *);
+void svc_ioq_zerocopy_reap(SVCXPRT *);
+void svc_ioq_zerocopy_destroy(struct poolq_head *);
 
 #endif				/* SVC_IOQ_H */
@@ -34,6 +34,14 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#if defined(TIRPC_IO_URING)
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
 
 #include <rpc/types.h>
 #include <misc/portable.h>
@@ -49,6 +57,7 @@
 #include "clnt_internal.h"
 #include "svc_internal.h"
 #include "svc_xprt.h"
+#include "svc_ioq.h"
 
 /**
  * @file svc_rqst.c
@@ -65,21 +74,56 @@
  */
 
 #define SVC_RQST_TIMEOUT_MS (29 /* seconds (prime) was 120 */ * 1000)
-#define SVC_RQST_WAKEUPS (1023)
+
+/* kernel busy poll packets per attempt (BUSY_POLL_BUDGET) */
+#define SVC_RQST_BUSY_POLL_BUDGET 8
 
 /* > RPC_DPLX_LOCKED > SVC_XPRT_FLAG_LOCKED */
 #define SVC_RQST_LOCKED		0x01000000
 #define SVC_RQST_UNLOCK		0x02000000
 
 static uint32_t round_robin;
-/*static*/ uint32_t wakeups;
+
+#if defined(TIRPC_IO_URING)
+/* user_data encoding: fd in the low 32 bits, hook generation above */
+#define SVC_RQST_URING_CTRL	(~0ULL)		/* control channel */
+#define SVC_RQST_URING_NOEV	(1ULL << 63)	/* completion only */
+#define SVC_RQST_URING_GEN	(0x7fffffffULL)
+
+struct svc_rqst_uring {
+	int ring_fd;
+	bool waiting;		/* loop is in io_uring_enter() */
+	uint32_t gen;
+	mutex_t sq_lock;
+
+	/* submission queue */
+	uint32_t *sq_khead;
+	uint32_t *sq_ktail;
+	uint32_t sq_mask;
+	uint32_t sq_entries;
+	uint32_t sq_tail;	/* locally queued */
+	struct io_uring_sqe *sqes;
+
+	/* completion queue */
+	uint32_t *cq_khead;
+	uint32_t *cq_ktail;
+	uint32_t cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *ring_p;
+	size_t ring_sz;
+	size_t sqes_sz;
+};
+#endif
 
 struct svc_rqst_rec {
 	struct work_pool_entry ev_wpe;
-	struct opr_rbtree call_expires;
-	mutex_t ev_lock;
+	struct timer_wheel call_expires;
+	pthread_spinlock_t ev_lock;	/* call_expires */
+	uint64_t ev_expire_wake;	/* loop sleeps until (ms) */
 
-	int sv[2];
+	int ev_fd;		/* eventfd wakeup */
+	uint32_t ev_sig_pending;
 	uint32_t id_k;		/* chan id */
 
 	/*
@@ -92,14 +136,38 @@ struct svc_rqst_rec {
 			int epoll_fd;
 			struct epoll_event ctrl_ev;
 			struct epoll_event *events;
+			struct work_pool_entry **wpes;	/* batch dispatch */
 			u_int max_events;	/* max epoll events */
 		} epoll;
+#endif
+#if defined(TIRPC_IO_URING)
+		struct {
+			struct svc_rqst_uring ring;
+			struct io_uring_cqe *events;
+			struct work_pool_entry **wpes;	/* batch dispatch */
+			u_int max_events;	/* max completions */
+		} io_uring;
 #endif
 		struct {
 			fd_set set;	/* select/fd_set (currently unhooked) */
 		} fd;
 	} ev_u;
 
+	struct svc_rqst_stats ev_stats;
+
+	int32_t ev_cpu;		/* SVC_RQST_FLAG_AFFINITY, or -1 */
+	int32_t ev_node;
+
+	/* SVC_FLAG_BUSY_POLL (nsec): the window after events is shortened
+	 * while it ends idle, and reset to the maximum on a hit.
+	 */
+	uint64_t ev_busy_max;		/* or 0 */
+	uint64_t ev_busy_window;
+	uint64_t ev_busy_until;		/* polling, while non-zero */
+
+	struct work_pool *ev_pool;	/* loop and transport tasks */
+	bool ev_pool_owned;		/* shut down with the channel set */
+
 	int32_t ev_refcnt;
 	uint16_t ev_flags;
 };
@@ -119,43 +187,251 @@ static struct svc_rqst_set svc_rqst_set = {
 };
 
 /*
- * Write 4-byte value to shared event-notification channel.  The
- * value as presently implemented can be interpreted only by one consumer,
- * so is not relied on.
+ * Wake the event channel.  Signals are coalesced:  until the event loop
+ * consumes the pending wakeup, further signals need no system call.
+ * The value as presently implemented can be interpreted only by one
+ * consumer, so is not relied on.
  */
 static inline void
-ev_sig(int fd, uint32_t sig)
+ev_sig(struct svc_rqst_rec *sr_rec, uint32_t sig)
 {
-	int code = write(fd, &sig, sizeof(uint32_t));
+	uint64_t value = 1;
+	int code;
+
+	if (atomic_postset_uint32_t_bits(&sr_rec->ev_sig_pending, 1)) {
+		atomic_inc_uint64_t(&sr_rec->ev_stats.ev_sigs_coalesced);
+		return;
+	}
+	atomic_inc_uint64_t(&sr_rec->ev_stats.ev_sigs);
+
+	code = write(sr_rec->ev_fd, &value, sizeof(value));
 
-	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST, "%s: fd %d sig %d", __func__, fd,
-		sig);
+	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST, "%s: fd %d sig %d", __func__,
+		sr_rec->ev_fd, sig);
 	if (code < 1)
 		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
-			"%s: error writing to event socket [%d:%d]", __func__,
+			"%s: error writing to eventfd [%d:%d]", __func__,
 			code, errno);
 }
 
 /*
- * Read a single 4-byte value from the shared event-notification channel,
- * the socket is in non-blocking mode.  The value read is returned.
+ * Consume all pending wakeups, the eventfd is in non-blocking mode.
+ * Cleared after reading, so a later signal always writes again.  A
+ * signal coalesced between the read and the clear is not written, so
+ * the event loop re-checks its state before waiting again.
  */
-static inline uint32_t
-consume_ev_sig_nb(int fd)
+static inline void
+consume_ev_sig_nb(struct svc_rqst_rec *sr_rec)
 {
-	uint32_t sig = 0;
+	uint64_t value;
 	int code __attribute__ ((unused));
 
-	code = read(fd, &sig, sizeof(uint32_t));
-	return (sig);
+	code = read(sr_rec->ev_fd, &value, sizeof(value));
+	atomic_clear_uint32_t_bits(&sr_rec->ev_sig_pending, 1);
 }
 
-static inline void
-SetNonBlock(int fd)
+#if defined(TIRPC_IO_URING)
+/*
+ * Minimal io_uring plumbing.  Only poll requests are used, so the
+ * mapping and queueing are kept here rather than requiring liburing.
+ */
+static inline int
+io_uring_setup_wr(unsigned entries, struct io_uring_params *p)
+{
+	return (syscall(__NR_io_uring_setup, entries, p));
+}
+
+static inline int
+io_uring_enter_wr(int fd, unsigned to_submit, unsigned min_complete,
+		  unsigned flags, void *arg, size_t argsz)
+{
+	return (syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			flags, arg, argsz));
+}
+
+static int
+svc_rqst_uring_create(struct svc_rqst_uring *ring, u_int entries)
+{
+	struct io_uring_params params;
+	uint32_t *sq_array;
+	uint8_t *p;
+	size_t cq_sz;
+	uint32_t ix;
+	int code;
+
+	memset(&params, 0, sizeof(params));
+	ring->ring_fd = io_uring_setup_wr(entries, &params);
+	if (ring->ring_fd < 0)
+		return (errno);
+
+	/* single mapping (5.4), and timeout on wait (5.11) */
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP)
+	 || !(params.features & IORING_FEAT_EXT_ARG)) {
+		code = ENOTSUP;
+		goto close_fd;
+	}
+
+	ring->ring_sz = params.sq_off.array
+		      + params.sq_entries * sizeof(uint32_t);
+	cq_sz = params.cq_off.cqes
+	      + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (ring->ring_sz < cq_sz)
+		ring->ring_sz = cq_sz;
+
+	ring->ring_p = mmap(NULL, ring->ring_sz, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+			    IORING_OFF_SQ_RING);
+	if (ring->ring_p == MAP_FAILED) {
+		code = errno;
+		goto close_fd;
+	}
+
+	ring->sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_sz, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+			  IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		code = errno;
+		goto unmap_ring;
+	}
+
+	p = ring->ring_p;
+	ring->sq_khead = (uint32_t *)(p + params.sq_off.head);
+	ring->sq_ktail = (uint32_t *)(p + params.sq_off.tail);
+	ring->sq_mask = *(uint32_t *)(p + params.sq_off.ring_mask);
+	ring->sq_entries = params.sq_entries;
+	ring->sq_tail = *ring->sq_ktail;
+
+	/* fixed identity, sqes are always used in order */
+	sq_array = (uint32_t *)(p + params.sq_off.array);
+	for (ix = 0; ix < params.sq_entries; ix++)
+		sq_array[ix] = ix;
+
+	ring->cq_khead = (uint32_t *)(p + params.cq_off.head);
+	ring->cq_ktail = (uint32_t *)(p + params.cq_off.tail);
+	ring->cq_mask = *(uint32_t *)(p + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(p + params.cq_off.cqes);
+
+	ring->waiting = false;
+	ring->gen = 0;
+	mutex_init(&ring->sq_lock, NULL);
+	return (0);
+
+ unmap_ring:
+	munmap(ring->ring_p, ring->ring_sz);
+ close_fd:
+	close(ring->ring_fd);
+	ring->ring_fd = -1;
+	return (code);
+}
+
+static void
+svc_rqst_uring_destroy(struct svc_rqst_uring *ring)
+{
+	mutex_destroy(&ring->sq_lock);
+	munmap(ring->sqes, ring->sqes_sz);
+	munmap(ring->ring_p, ring->ring_sz);
+	close(ring->ring_fd);
+	ring->ring_fd = -1;
+}
+
+/*
+ * sq_lock held
+ */
+static inline uint32_t
+svc_rqst_uring_unsubmitted(struct svc_rqst_uring *ring)
+{
+	return (ring->sq_tail - atomic_fetch_uint32_t(ring->sq_khead));
+}
+
+/*
+ * sq_lock held
+ */
+static int
+svc_rqst_uring_submit(struct svc_rqst_uring *ring)
+{
+	uint32_t to_submit = svc_rqst_uring_unsubmitted(ring);
+	int code;
+
+	if (!to_submit)
+		return (0);
+
+	code = io_uring_enter_wr(ring->ring_fd, to_submit, 0, 0, NULL, 0);
+	if (code < 0)
+		return (errno);
+	return (0);
+}
+
+/**
+ * @brief Queue a poll request
+ *
+ * Completions of poll requests are run in the context of the submitting
+ * thread, so requests are only submitted by the thread running the event
+ * loop, batched into its next io_uring_enter().  Rearming a transport
+ * while the loop is busy does not need a system call.
+ *
+ * @param[in] ring	io_uring of the channel
+ * @param[in] opcode	IORING_OP_POLL_ADD or IORING_OP_POLL_REMOVE
+ * @param[in] fd	polled fd (add)
+ * @param[in] addr	user_data of the request to remove (remove)
+ * @param[in] poll_mask	polled events (add), or replacement events when
+ *			updating rather than removing (remove)
+ * @param[in] user_data	returned in the completion
+ * @param[out] wakeup	loop is waiting, must be signalled
+ */
+static int
+svc_rqst_uring_post(struct svc_rqst_uring *ring, uint8_t opcode, int fd,
+		    uint64_t addr, uint32_t poll_mask, uint64_t user_data,
+		    bool *wakeup)
+{
+	struct io_uring_sqe *sqe;
+	int code;
+
+	mutex_lock(&ring->sq_lock);
+
+	if (svc_rqst_uring_unsubmitted(ring) >= ring->sq_entries) {
+		/* full, cannot wait for the loop */
+		code = svc_rqst_uring_submit(ring);
+		if (code || svc_rqst_uring_unsubmitted(ring)
+			    >= ring->sq_entries) {
+			mutex_unlock(&ring->sq_lock);
+			return (code ? code : EBUSY);
+		}
+	}
+
+	sqe = &ring->sqes[ring->sq_tail & ring->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = addr;
+	if (opcode == IORING_OP_POLL_REMOVE && poll_mask)
+		sqe->len = IORING_POLL_UPDATE_EVENTS;
+#if __BYTE_ORDER == __BIG_ENDIAN
+	poll_mask = (poll_mask << 16) | (poll_mask >> 16);
+#endif
+	sqe->poll32_events = poll_mask;
+	sqe->user_data = user_data;
+
+	ring->sq_tail++;
+	atomic_store_uint32_t(ring->sq_ktail, ring->sq_tail);
+	*wakeup = ring->waiting;
+
+	mutex_unlock(&ring->sq_lock);
+	return (0);
+}
+
+/*
+ * Oneshot, so that each wakeup is completed by the waiting thread.
+ */
+static inline int
+svc_rqst_uring_ctrl(struct svc_rqst_uring *ring, int fd)
 {
-	int s_flags = fcntl(fd, F_GETFL, 0);
-	(void)fcntl(fd, F_SETFL, (s_flags | O_NONBLOCK));
+	bool wakeup;
+
+	return svc_rqst_uring_post(ring, IORING_OP_POLL_ADD, fd, 0, POLLIN,
+				   SVC_RQST_URING_CTRL, &wakeup);
 }
+#endif /* TIRPC_IO_URING */
 
 void
 svc_rqst_init(uint32_t channels)
@@ -196,57 +472,39 @@ svc_rqst_lookup_chan(uint32_t chan_id)
 /* forward declaration in lieu of moving code {WAS} */
 static void svc_rqst_run_task(struct work_pool_entry *);
 
-static int
-svc_rqst_expire_cmpf(const struct opr_rbtree_node *lhs,
-		     const struct opr_rbtree_node *rhs)
-{
-	struct clnt_req *lk, *rk;
-
-	lk = opr_containerof(lhs, struct clnt_req, cc_rqst);
-	rk = opr_containerof(rhs, struct clnt_req, cc_rqst);
-
-	if (lk->cc_expire_ms < rk->cc_expire_ms)
-		return (-1);
-
-	if (lk->cc_expire_ms == rk->cc_expire_ms) {
-		return (0);
-	}
-
-	return (1);
-}
-
-static inline int
-svc_rqst_expire_ms(struct timespec *to)
+/* coarse nsec, not system time */
+static inline uint64_t
+svc_rqst_expire_now(void)
 {
 	struct timespec ts;
 
-	/* coarse nsec, not system time */
 	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &ts);
-	timespecadd(&ts, to, &ts);
-	return timespec_ms(&ts);
+	return (timespec_ms(&ts));
 }
 
+/*
+ * The loop is woken only when the call expires before it would wake
+ * anyway.  Removal never wakes it:  an early wakeup finds nothing due.
+ */
 void
 svc_rqst_expire_insert(struct clnt_req *cc)
 {
 	struct cx_data *cx = CX_DATA(cc->cc_clnt);
 	struct svc_rqst_rec *sr_rec = (struct svc_rqst_rec *)cx->cx_rec->ev_p;
-	struct opr_rbtree_node *nv;
-
-	cc->cc_expire_ms = svc_rqst_expire_ms(&cc->cc_timeout);
+	uint64_t expire_ms = svc_rqst_expire_now()
+			   + timespec_ms(&cc->cc_timeout);
+	bool wake;
 
-	mutex_lock(&sr_rec->ev_lock);
+	pthread_spin_lock(&sr_rec->ev_lock);
 	cc->cc_flags = CLNT_REQ_FLAG_EXPIRING;
- repeat:
-	nv = opr_rbtree_insert(&sr_rec->call_expires, &cc->cc_rqst);
-	if (nv) {
-		/* add this slightly later */
-		cc->cc_expire_ms++;
-		goto repeat;
-	}
-	mutex_unlock(&sr_rec->ev_lock);
-
-	ev_sig(sr_rec->sv[0], 0);	/* send wakeup */
+	timer_wheel_insert(&sr_rec->call_expires, &cc->cc_rqst, expire_ms);
+	wake = expire_ms < sr_rec->ev_expire_wake;
+	if (wake)
+		sr_rec->ev_expire_wake = expire_ms;
+	pthread_spin_unlock(&sr_rec->ev_lock);
+
+	if (wake)
+		ev_sig(sr_rec, 0);	/* send wakeup */
 }
 
 void
@@ -255,11 +513,9 @@ svc_rqst_expire_remove(struct clnt_req *cc)
 	struct cx_data *cx = CX_DATA(cc->cc_clnt);
 	struct svc_rqst_rec *sr_rec = cx->cx_rec->ev_p;
 
-	mutex_lock(&sr_rec->ev_lock);
-	opr_rbtree_remove(&sr_rec->call_expires, &cc->cc_rqst);
-	mutex_unlock(&sr_rec->ev_lock);
-
-	ev_sig(sr_rec->sv[0], 0);	/* send wakeup */
+	pthread_spin_lock(&sr_rec->ev_lock);
+	timer_wheel_remove(&sr_rec->call_expires, &cc->cc_rqst);
+	pthread_spin_unlock(&sr_rec->ev_lock);
 }
 
 static void
@@ -281,13 +537,56 @@ svc_rqst_expire_task(struct work_pool_entry *wpe)
 	clnt_req_release(cc);
 }
 
-int
-svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
+#if defined(TIRPC_EPOLL)
+/*
+ * Ask the kernel to busy poll the device queues of this epoll instance
+ * as well (Linux 6.9+).  Not fatal:  polling continues in user space.
+ */
+static void
+svc_rqst_epoll_busy_params(struct svc_rqst_rec *sr_rec)
+{
+#if defined(EPIOCSPARAMS)
+	struct epoll_params params = {
+		.busy_poll_usecs = __svc_params->busy_poll_us,
+		.busy_poll_budget = SVC_RQST_BUSY_POLL_BUDGET,
+		.prefer_busy_poll = 0,
+	};
+
+	if (ioctl(sr_rec->ev_u.epoll.epoll_fd, EPIOCSPARAMS, &params) < 0)
+		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: epoll_fd %d EPIOCSPARAMS failed (%d)",
+			__func__, sr_rec->ev_u.epoll.epoll_fd, errno);
+#endif
+}
+#endif
+
+/*
+ * Work pool for tasks of a transport: its channel's, or the global pool.
+ */
+struct work_pool *
+svc_rqst_work_pool(SVCXPRT *xprt)
+{
+	struct svc_rqst_rec *sr_rec = REC_XPRT(xprt)->ev_p;
+
+	if (sr_rec && sr_rec->ev_pool)
+		return (sr_rec->ev_pool);
+	return (&svc_work_pool);
+}
+
+/*
+ * pool: NULL for svc_work_pool.  Returns with *created false when an
+ * existing channel was re-used (the pool was not taken).
+ */
+static int
+svc_rqst_new_evchan_impl(uint32_t *chan_id /* OUT */, void *u_data,
+			 uint32_t flags, struct work_pool *pool, bool owned,
+			 bool *created)
 {
 	struct svc_rqst_rec *sr_rec;
 	uint32_t n_id;
 	int code = 0;
 
+	*created = false;
 	mutex_lock(&svc_rqst_set.mtx);
 	if (!svc_rqst_set.next_id) {
 		/* too many new channels, re-use global default, may be zero */
@@ -305,23 +604,65 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 		mutex_unlock(&svc_rqst_set.mtx);
 		return (0);
 	}
+	*created = true;
+	sr_rec->ev_pool = pool ? pool : &svc_work_pool;
+	sr_rec->ev_pool_owned = owned;
 
 	flags |= SVC_RQST_FLAG_EPOLL;	/* XXX */
+#if defined(TIRPC_IO_URING)
+	if (__svc_params->ev_type == SVC_EVENT_IO_URING)
+		flags |= SVC_RQST_FLAG_IO_URING;
+#endif
 
-	/* create a pair of anonymous sockets for async event channel wakeups */
-	code = socketpair(AF_UNIX, SOCK_STREAM, 0, sr_rec->sv);
-	if (code) {
+	/* create an eventfd for async event channel wakeups */
+	sr_rec->ev_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (sr_rec->ev_fd < 0) {
+		code = errno;
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
-			"%s: failed creating event signal socketpair (%d)",
+			"%s: failed creating event signal eventfd (%d)",
 			__func__, code);
 		++(svc_rqst_set.next_id);
 		mutex_unlock(&svc_rqst_set.mtx);
 		return (code);
 	}
+	sr_rec->ev_sig_pending = 0;
+	memset(&sr_rec->ev_stats, 0, sizeof(sr_rec->ev_stats));
+
+	sr_rec->ev_busy_max = (__svc_params->flags & SVC_FLAG_BUSY_POLL)
+		? (uint64_t)__svc_params->busy_poll_us * 1000 : 0;
+	sr_rec->ev_busy_window = sr_rec->ev_busy_max;
+	sr_rec->ev_busy_until = 0;
 
-	/* set non-blocking */
-	SetNonBlock(sr_rec->sv[0]);
-	SetNonBlock(sr_rec->sv[1]);
+#if defined(TIRPC_IO_URING)
+	if (flags & SVC_RQST_FLAG_IO_URING) {
+		struct svc_rqst_uring *ring = &sr_rec->ev_u.io_uring.ring;
+
+		sr_rec->ev_u.io_uring.max_events =
+		    __svc_params->ev_u.evchan.max_events;
+		code = svc_rqst_uring_create(ring,
+					     sr_rec->ev_u.io_uring.max_events);
+		if (!code) {
+			code = svc_rqst_uring_ctrl(ring, sr_rec->ev_fd);
+			if (code) {
+				__warnx(TIRPC_DEBUG_FLAG_ERROR,
+					"%s: add control socket failed (%d)",
+					__func__, code);
+			}
+			sr_rec->ev_type = SVC_EVENT_IO_URING;
+			sr_rec->ev_u.io_uring.events = (struct io_uring_cqe *)
+			    mem_alloc(sr_rec->ev_u.io_uring.max_events *
+				      sizeof(struct io_uring_cqe));
+			sr_rec->ev_u.io_uring.wpes = (struct work_pool_entry **)
+			    mem_alloc(sr_rec->ev_u.io_uring.max_events *
+				      sizeof(struct work_pool_entry *));
+			goto created;
+		}
+		__warnx(TIRPC_DEBUG_FLAG_WARN,
+			"%s: io_uring unavailable (%d), using epoll",
+			__func__, code);
+		code = 0;
+	}
+#endif
 
 #if defined(TIRPC_EPOLL)
 	if (flags & SVC_RQST_FLAG_EPOLL) {
@@ -333,6 +674,9 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 		sr_rec->ev_u.epoll.events = (struct epoll_event *)
 		    mem_alloc(sr_rec->ev_u.epoll.max_events *
 			      sizeof(struct epoll_event));
+		sr_rec->ev_u.epoll.wpes = (struct work_pool_entry **)
+		    mem_alloc(sr_rec->ev_u.epoll.max_events *
+			      sizeof(struct work_pool_entry *));
 
 		/* create epoll fd */
 		sr_rec->ev_u.epoll.epoll_fd =
@@ -346,6 +690,10 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 			mem_free(sr_rec->ev_u.epoll.events,
 				 sr_rec->ev_u.epoll.max_events *
 				 sizeof(struct epoll_event));
+			mem_free(sr_rec->ev_u.epoll.wpes,
+				 sr_rec->ev_u.epoll.max_events *
+				 sizeof(struct work_pool_entry *));
+			close(sr_rec->ev_fd);
 			++(svc_rqst_set.next_id);
 			mutex_unlock(&svc_rqst_set.mtx);
 			return (EINVAL);
@@ -355,16 +703,18 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 		 * couple of possible semantics */
 		sr_rec->ev_u.epoll.ctrl_ev.events =
 		    EPOLLIN | EPOLLRDHUP;
-		sr_rec->ev_u.epoll.ctrl_ev.data.fd = sr_rec->sv[1];
+		sr_rec->ev_u.epoll.ctrl_ev.data.fd = sr_rec->ev_fd;
 		code =
 		    epoll_ctl(sr_rec->ev_u.epoll.epoll_fd, EPOLL_CTL_ADD,
-			      sr_rec->sv[1], &sr_rec->ev_u.epoll.ctrl_ev);
+			      sr_rec->ev_fd, &sr_rec->ev_u.epoll.ctrl_ev);
 		if (code == -1) {
 			code = errno;
 			__warnx(TIRPC_DEBUG_FLAG_ERROR,
 				"%s: add control socket failed (%d)", __func__,
 				code);
 		}
+		if (sr_rec->ev_busy_max)
+			svc_rqst_epoll_busy_params(sr_rec);
 	} else {
 		/* legacy fdset (currently unhooked) */
 		sr_rec->ev_type = SVC_EVENT_FDSET;
@@ -373,24 +723,89 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 	sr_rec->ev_type = SVC_EVENT_FDSET;
 #endif
 
+#if defined(TIRPC_IO_URING)
+ created:
+#endif
 	*chan_id =
 	sr_rec->id_k = n_id;
 	sr_rec->ev_flags = flags & SVC_RQST_FLAG_MASK;
-	opr_rbtree_init(&sr_rec->call_expires, svc_rqst_expire_cmpf);
-	mutex_init(&sr_rec->ev_lock, NULL);
+	timer_wheel_init(&sr_rec->call_expires, svc_rqst_expire_now());
+	sr_rec->ev_expire_wake = 0;
+	pthread_spin_init(&sr_rec->ev_lock, PTHREAD_PROCESS_PRIVATE);
+
+	/* the event loop and its transports prefer workers bound near
+	 * this CPU, one per channel in turn
+	 */
+	sr_rec->ev_cpu = -1;
+	sr_rec->ev_node = -1;
+	if ((flags & SVC_RQST_FLAG_AFFINITY)
+	 || (__svc_params->flags & SVC_FLAG_AFFINITY)) {
+		sr_rec->ev_cpu = work_pool_cpu(n_id);
+		sr_rec->ev_node = work_pool_cpu_node(sr_rec->ev_cpu);
+	}
 
 	if (!code) {
+		struct work_pool_entry *wpe = &sr_rec->ev_wpe;
+
 		atomic_inc_int32_t(&sr_rec->ev_refcnt);
 		sr_rec->ev_wpe.fun = svc_rqst_run_task;
 		sr_rec->ev_wpe.arg = u_data;
-		work_pool_submit(&svc_work_pool, &sr_rec->ev_wpe);
+		work_pool_submit_near(sr_rec->ev_pool, &wpe, 1,
+				      sr_rec->ev_node, sr_rec->ev_cpu);
 	}
 	mutex_unlock(&svc_rqst_set.mtx);
 
 	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
-		"%s: create evchan %d control fd pair (%d:%d)",
+		"%s: create evchan %d control fd %d cpu %" PRId32
+		" node %" PRId32,
 		__func__, n_id,
-		sr_rec->sv[0], sr_rec->sv[1]);
+		sr_rec->ev_fd, sr_rec->ev_cpu, sr_rec->ev_node);
+	return (code);
+}
+
+int
+svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
+{
+	bool created;
+
+	return (svc_rqst_new_evchan_impl(chan_id, u_data, flags, NULL, false,
+					 &created));
+}
+
+/*
+ * Channel with a dedicated work pool, for its event loop and the tasks
+ * of its transports.  One thread is added to params for the loop.
+ */
+int
+svc_rqst_new_evchan_pool(uint32_t *chan_id /* OUT */, void *u_data,
+			 uint32_t flags, const struct work_pool_params *params)
+{
+	struct work_pool_params wpp = *params;
+	struct work_pool *pool;
+	bool created;
+	int code;
+
+	wpp.thrd_min++;
+	if (wpp.thrd_max < wpp.thrd_min)
+		wpp.thrd_max = wpp.thrd_min;
+
+	pool = mem_zalloc(sizeof(*pool));
+	code = work_pool_init(pool, "evch", &wpp);
+	if (code) {
+		mem_free(pool, sizeof(*pool));
+		return (code);
+	}
+
+	code = svc_rqst_new_evchan_impl(chan_id, u_data, flags, pool, true,
+					&created);
+	if (!created) {
+		__warnx(TIRPC_DEBUG_FLAG_WARN,
+			"%s: no new channel, evchan %" PRIu32
+			" keeps its work pool",
+			__func__, *chan_id);
+		work_pool_shutdown(pool);
+		mem_free(pool, sizeof(*pool));
+	}
 	return (code);
 }
 
@@ -401,11 +816,35 @@ svc_rqst_release(struct svc_rqst_rec *sr_rec)
 		return;
 
 	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
-		"%s: remove evchan %d control fd pair (%d:%d)",
+		"%s: remove evchan %d control fd %d",
 		__func__, sr_rec->id_k,
-		sr_rec->sv[0], sr_rec->sv[1]);
+		sr_rec->ev_fd);
 
-	mutex_destroy(&sr_rec->ev_lock);
+	close(sr_rec->ev_fd);
+	pthread_spin_destroy(&sr_rec->ev_lock);
+}
+
+/*
+ * Channel sharing the work pool of pool_chan_id, forming a group.  The
+ * pool limits should allow for one event loop per channel of the group.
+ */
+int
+svc_rqst_new_evchan_shared(uint32_t *chan_id /* OUT */, void *u_data,
+			   uint32_t flags, uint32_t pool_chan_id)
+{
+	struct svc_rqst_rec *owner = svc_rqst_lookup_chan(pool_chan_id);
+	struct work_pool *pool;
+	bool created;
+	int code;
+
+	if (!owner)
+		return (ENOENT);
+	pool = owner->ev_pool;
+	svc_rqst_release(owner);
+
+	code = svc_rqst_new_evchan_impl(chan_id, u_data, flags, pool, false,
+					&created);
+	return (code);
 }
 
 /*
@@ -430,26 +869,50 @@ svc_rqst_unhook_events(struct rpc_dplx_rec *rec, struct svc_rqst_rec *sr_rec)
 			__warnx(TIRPC_DEBUG_FLAG_WARN,
 				"%s: %p fd %d xp_refcnt %" PRId32
 				" sr_rec %p evchan %d ev_refcnt %" PRId32
-				" epoll_fd %d control fd pair (%d:%d) unhook failed (%d)",
+				" epoll_fd %d control fd %d unhook failed (%d)",
 				__func__, rec, rec->xprt.xp_fd,
 				rec->xprt.xp_refcnt,
 				sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
 				sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1], code);
+				sr_rec->ev_fd, code);
 		} else {
 			__warnx(TIRPC_DEBUG_FLAG_SVC_RQST |
 				TIRPC_DEBUG_FLAG_REFCNT,
 				"%s: %p fd %d xp_refcnt %" PRId32
 				" sr_rec %p evchan %d ev_refcnt %" PRId32
-				" epoll_fd %d control fd pair (%d:%d) unhook",
+				" epoll_fd %d control fd %d unhook",
 				__func__, rec, rec->xprt.xp_fd,
 				rec->xprt.xp_refcnt,
 				sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
 				sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1]);
+				sr_rec->ev_fd);
 		}
 		break;
 	}
+#endif
+#if defined(TIRPC_IO_URING)
+	case SVC_EVENT_IO_URING:
+	{
+		bool wakeup;
+
+		/* cancel the outstanding poll, releasing its file reference */
+		code = svc_rqst_uring_post(&sr_rec->ev_u.io_uring.ring,
+					   IORING_OP_POLL_REMOVE, -1,
+					   rec->ev_u.io_uring.user_data, 0,
+					   SVC_RQST_URING_NOEV, &wakeup);
+		if (!code && wakeup)
+			ev_sig(sr_rec, 0);	/* send wakeup */
+		__warnx(code ? TIRPC_DEBUG_FLAG_WARN
+			     : TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: %p fd %d xp_refcnt %" PRId32
+			" sr_rec %p evchan %d ev_refcnt %" PRId32
+			" ring_fd %d unhook (%d)",
+			__func__, rec, rec->xprt.xp_fd,
+			rec->xprt.xp_refcnt,
+			sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
+			sr_rec->ev_u.io_uring.ring.ring_fd, code);
+		break;
+	}
 #endif
 	default:
 		/* XXX formerly select/fd_set case, now placeholder for new
@@ -460,6 +923,62 @@ svc_rqst_unhook_events(struct rpc_dplx_rec *rec, struct svc_rqst_rec *sr_rec)
 	return (code);
 }
 
+/*
+ * Input, unless paused over output budget; output, while blocked.
+ */
+static inline uint32_t
+svc_rqst_poll_mask(SVCXPRT *xprt)
+{
+	uint32_t poll_mask = 0;
+
+	if (!(xprt->xp_flags & SVC_XPRT_FLAG_PAUSED))
+		poll_mask |= POLLIN;
+	if (xprt->xp_flags & SVC_XPRT_FLAG_BLOCKED)
+		poll_mask |= POLLOUT;
+	return (poll_mask);
+}
+
+#if defined(TIRPC_IO_URING)
+/*
+ * RPC_DPLX_LOCKED, and SVC_XPRT_FLAG_ADDED set
+ *
+ * Unlike EPOLL_CTL_MOD, no system call while the event loop is busy.
+ */
+static inline int
+svc_rqst_uring_poll(struct rpc_dplx_rec *rec, struct svc_rqst_rec *sr_rec,
+		    bool *wakeup, const char *func)
+{
+	int code = svc_rqst_uring_post(&sr_rec->ev_u.io_uring.ring,
+				       IORING_OP_POLL_ADD, rec->xprt.xp_fd, 0,
+				       svc_rqst_poll_mask(&rec->xprt),
+				       rec->ev_u.io_uring.user_data, wakeup);
+
+	if (code) {
+		atomic_clear_uint16_t_bits(&rec->xprt.xp_flags,
+					   SVC_XPRT_FLAG_ADDED);
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d xp_refcnt %" PRId32
+			" sr_rec %p evchan %d ev_refcnt %" PRId32
+			" ring_fd %d poll failed (%d)",
+			func, rec, rec->xprt.xp_fd,
+			rec->xprt.xp_refcnt,
+			sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
+			sr_rec->ev_u.io_uring.ring.ring_fd, code);
+	} else {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST |
+			TIRPC_DEBUG_FLAG_REFCNT,
+			"%s: %p fd %d xp_refcnt %" PRId32
+			" sr_rec %p evchan %d ev_refcnt %" PRId32
+			" ring_fd %d poll",
+			func, rec, rec->xprt.xp_fd,
+			rec->xprt.xp_refcnt,
+			sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
+			sr_rec->ev_u.io_uring.ring.ring_fd);
+	}
+	return (code);
+}
+#endif
+
 /*
  * not locked
  */
@@ -477,10 +996,20 @@ svc_rqst_rearm_events(SVCXPRT *xprt)
 	if (sr_rec->ev_flags & SVC_RQST_FLAG_SHUTDOWN)
 		return (0);
 
+	/* over output budget, svc_ioq rearms when drained */
+	if (svc_ioq_pause(xprt)
+	 && !(xprt->xp_flags & SVC_XPRT_FLAG_BLOCKED))
+		return (0);
+
 	rpc_dplx_rli(rec);
 
 	/* assuming success */
-	atomic_set_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_ADDED);
+	if (atomic_postset_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_ADDED)
+	    & SVC_XPRT_FLAG_ADDED) {
+		/* armed meanwhile (svc_rqst_output_events) */
+		rpc_dplx_rui(rec);
+		return (0);
+	}
 
 	switch (sr_rec->ev_type) {
 #if defined(TIRPC_EPOLL)
@@ -489,7 +1018,7 @@ svc_rqst_rearm_events(SVCXPRT *xprt)
 		struct epoll_event *ev = &rec->ev_u.epoll.event;
 
 		/* set up epoll user data */
-		ev->events = EPOLLIN | EPOLLONESHOT;
+		ev->events = svc_rqst_poll_mask(xprt) | EPOLLONESHOT;
 
 		/* rearm in epoll vector */
 		code = epoll_ctl(sr_rec->ev_u.epoll.epoll_fd,
@@ -501,34 +1030,160 @@ svc_rqst_rearm_events(SVCXPRT *xprt)
 			__warnx(TIRPC_DEBUG_FLAG_ERROR,
 				"%s: %p fd %d xp_refcnt %" PRId32
 				" sr_rec %p evchan %d ev_refcnt %" PRId32
-				" epoll_fd %d control fd pair (%d:%d) rearm failed (%d)",
+				" epoll_fd %d control fd %d rearm failed (%d)",
 				__func__, rec, rec->xprt.xp_fd,
 				rec->xprt.xp_refcnt,
 				sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
 				sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1], code);
+				sr_rec->ev_fd, code);
 			SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
 		} else {
 			__warnx(TIRPC_DEBUG_FLAG_SVC_RQST |
 				TIRPC_DEBUG_FLAG_REFCNT,
 				"%s: %p fd %d xp_refcnt %" PRId32
 				" sr_rec %p evchan %d ev_refcnt %" PRId32
-				" epoll_fd %d control fd pair (%d:%d) rearm",
+				" epoll_fd %d control fd %d rearm",
 				__func__, rec, rec->xprt.xp_fd,
 				rec->xprt.xp_refcnt,
 				sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
 				sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1]);
+				sr_rec->ev_fd);
+		}
+		break;
+	}
+#endif
+#if defined(TIRPC_IO_URING)
+	case SVC_EVENT_IO_URING:
+	{
+		bool wakeup;
+
+		code = svc_rqst_uring_poll(rec, sr_rec, &wakeup, __func__);
+		if (code)
+			SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		else if (wakeup)
+			ev_sig(sr_rec, 0);	/* send wakeup */
+		break;
+	}
+#endif
+	default:
+		/* XXX formerly select/fd_set case, now placeholder for new
+		 * event systems, reworked select, etc. */
+		break;
+	}			/* switch */
+
+	rpc_dplx_rui(rec);
+
+	return (code);
+}
+
+/*
+ * Output would block, so also wait for POLLOUT until the next event,
+ * when svc_rqst_xprt_task() resumes it.  A transport that is not armed
+ * has a running task (or is unhooked), and the next rearm adds POLLOUT;
+ * unless paused over its output budget, then armed for POLLOUT alone.
+ *
+ * not locked
+ */
+int
+svc_rqst_output_events(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_rqst_rec *sr_rec = (struct svc_rqst_rec *)rec->ev_p;
+	bool rearm = false;
+	int code = 0;
+
+	if (!sr_rec)
+		return (EINVAL);
+
+	rpc_dplx_rli(rec);
+
+	atomic_set_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_BLOCKED);
+
+	if ((xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)
+	 || (sr_rec->ev_flags & SVC_RQST_FLAG_SHUTDOWN))
+		goto unlock;
+
+	if (!(xprt->xp_flags & SVC_XPRT_FLAG_ADDED)) {
+		if (!(xprt->xp_flags & SVC_XPRT_FLAG_PAUSED))
+			goto unlock;
+
+		/* paused over output budget, no task will rearm */
+		atomic_set_uint16_t_bits(&xprt->xp_flags,
+					 SVC_XPRT_FLAG_ADDED);
+		rearm = true;
+	}
+
+	switch (sr_rec->ev_type) {
+#if defined(TIRPC_EPOLL)
+	case SVC_EVENT_EPOLL:
+	{
+		struct epoll_event *ev = &rec->ev_u.epoll.event;
+
+		ev->events = svc_rqst_poll_mask(xprt) | EPOLLONESHOT;
+
+		/* an event may have fired, then an extra event is ignored */
+		code = epoll_ctl(sr_rec->ev_u.epoll.epoll_fd,
+				 EPOLL_CTL_MOD, xprt->xp_fd, ev);
+		if (code) {
+			code = errno;
+			if (rearm)
+				atomic_clear_uint16_t_bits(&xprt->xp_flags,
+							   SVC_XPRT_FLAG_ADDED);
+		}
+		__warnx(code ? TIRPC_DEBUG_FLAG_ERROR
+			     : TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: %p fd %d xp_refcnt %" PRId32
+			" sr_rec %p evchan %d ev_refcnt %" PRId32
+			" epoll_fd %d control fd %d output (%d)",
+			__func__, rec, rec->xprt.xp_fd,
+			rec->xprt.xp_refcnt,
+			sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
+			sr_rec->ev_u.epoll.epoll_fd,
+			sr_rec->ev_fd, code);
+		break;
+	}
+#endif
+#if defined(TIRPC_IO_URING)
+	case SVC_EVENT_IO_URING:
+	{
+		bool wakeup;
+
+		if (rearm) {
+			code = svc_rqst_uring_poll(rec, sr_rec, &wakeup,
+						   __func__);
+			if (!code && wakeup)
+				ev_sig(sr_rec, 0);	/* send wakeup */
+			break;
 		}
+
+		/* update the outstanding poll, if it has not completed */
+		code = svc_rqst_uring_post(&sr_rec->ev_u.io_uring.ring,
+					   IORING_OP_POLL_REMOVE, -1,
+					   rec->ev_u.io_uring.user_data,
+					   svc_rqst_poll_mask(xprt),
+					   SVC_RQST_URING_NOEV, &wakeup);
+		if (!code && wakeup)
+			ev_sig(sr_rec, 0);	/* send wakeup */
+		__warnx(code ? TIRPC_DEBUG_FLAG_ERROR
+			     : TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: %p fd %d xp_refcnt %" PRId32
+			" sr_rec %p evchan %d ev_refcnt %" PRId32
+			" ring_fd %d output (%d)",
+			__func__, rec, rec->xprt.xp_fd,
+			rec->xprt.xp_refcnt,
+			sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
+			sr_rec->ev_u.io_uring.ring.ring_fd, code);
 		break;
 	}
 #endif
 	default:
-		/* XXX formerly select/fd_set case, now placeholder for new
-		 * event systems, reworked select, etc. */
 		break;
 	}			/* switch */
 
+ unlock:
+	if (code)
+		atomic_clear_uint16_t_bits(&xprt->xp_flags,
+					   SVC_XPRT_FLAG_BLOCKED);
 	rpc_dplx_rui(rec);
 
 	return (code);
@@ -564,26 +1219,42 @@ svc_rqst_hook_events(struct rpc_dplx_rec *rec, struct svc_rqst_rec *sr_rec)
 			__warnx(TIRPC_DEBUG_FLAG_ERROR,
 				"%s: %p fd %d xp_refcnt %" PRId32
 				" sr_rec %p evchan %d ev_refcnt %" PRId32
-				" epoll_fd %d control fd pair (%d:%d) hook failed (%d)",
+				" epoll_fd %d control fd %d hook failed (%d)",
 				__func__, rec, rec->xprt.xp_fd,
 				rec->xprt.xp_refcnt,
 				sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
 				sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1], code);
+				sr_rec->ev_fd, code);
 		} else {
 			__warnx(TIRPC_DEBUG_FLAG_SVC_RQST |
 				TIRPC_DEBUG_FLAG_REFCNT,
 				"%s: %p fd %d xp_refcnt %" PRId32
 				" sr_rec %p evchan %d ev_refcnt %" PRId32
-				" epoll_fd %d control fd pair (%d:%d) hook",
+				" epoll_fd %d control fd %d hook",
 				__func__, rec, rec->xprt.xp_fd,
 				rec->xprt.xp_refcnt,
 				sr_rec, sr_rec->id_k, sr_rec->ev_refcnt,
 				sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1]);
+				sr_rec->ev_fd);
 		}
 		break;
 	}
+#endif
+#if defined(TIRPC_IO_URING)
+	case SVC_EVENT_IO_URING:
+	{
+		/* distinguish stale completions after fd re-use */
+		uint64_t gen = atomic_inc_uint32_t(
+					&sr_rec->ev_u.io_uring.ring.gen)
+			     & SVC_RQST_URING_GEN;
+
+		bool wakeup;
+
+		rec->ev_u.io_uring.user_data =
+			(gen << 32) | (uint32_t)rec->xprt.xp_fd;
+		code = svc_rqst_uring_poll(rec, sr_rec, &wakeup, __func__);
+		break;
+	}
 #endif
 	default:
 		/* XXX formerly select/fd_set case, now placeholder for new
@@ -591,7 +1262,7 @@ svc_rqst_hook_events(struct rpc_dplx_rec *rec, struct svc_rqst_rec *sr_rec)
 		break;
 	}			/* switch */
 
-	ev_sig(sr_rec->sv[0], 0);	/* send wakeup */
+	ev_sig(sr_rec, 0);	/* send wakeup */
 
 	return (code);
 }
@@ -775,79 +1446,138 @@ svc_rqst_xprt_task(struct work_pool_entry *wpe)
 		/* (idempotent) xp_flags and xp_refcnt are set atomic.
 		 * xp_refcnt need more than 1 (this task).
 		 */
+		if (unlikely(rec->ev_events & POLLOUT)) {
+			/* output was blocked (SVC_FLAG_NONBLOCK_OUT) */
+			svc_ioq_write_resume(&rec->xprt);
+
+			if (!(rec->ev_events & ~POLLOUT)) {
+				/* nothing to receive, wait again */
+				if (unlikely(svc_rqst_rearm_events(&rec->xprt)))
+					SVC_DESTROY(&rec->xprt);
+				goto release;
+			}
+		}
 		(void)clock_gettime(CLOCK_MONOTONIC_FAST, &(rec->recv.ts));
 		(void)SVC_RECV(&rec->xprt);
 	}
 
+ release:
 
 	/* Release the ref taken on the event */
 	SVC_RELEASE(&rec->xprt, SVC_RELEASE_FLAG_NONE);
 }
+
 /*
- * Like __svc_clean_idle but event-type independent.  For now no cleanfds.
+ * Expire client calls, returning the wait (ms) until the next expiry.
+ * Called before waiting, so events will accumulate during the scan.
  */
-
-struct svc_rqst_clean_arg {
-	struct timespec ts;
-	int timeout;
-	int cleaned;
-};
-
-static bool
-svc_rqst_clean_func(SVCXPRT *xprt, void *arg)
+static inline int
+svc_rqst_expire_events(struct svc_rqst_rec *sr_rec)
 {
-	struct svc_rqst_clean_arg *acc = (struct svc_rqst_clean_arg *)arg;
+	struct timer_wheel_list expired = TAILQ_HEAD_INITIALIZER(expired);
+	struct timer_wheel_entry *twe;
+	struct timer_wheel_entry *next;
+	struct clnt_req *cc;
+	uint64_t now = svc_rqst_expire_now();
+	int timeout_ms;
 
-	if (xprt->xp_ops == NULL)
-		return (false);
+	pthread_spin_lock(&sr_rec->ev_lock);
+	timeout_ms = timer_wheel_expire(&sr_rec->call_expires, now, &expired,
+					SVC_RQST_TIMEOUT_MS);
+	sr_rec->ev_expire_wake = now + timeout_ms;
 
-	if (xprt->xp_flags & (SVC_XPRT_FLAG_DESTROYED | SVC_XPRT_FLAG_UREG))
-		return (false);
+	TAILQ_FOREACH_SAFE(twe, &expired, twe_q, next) {
+		cc = opr_containerof(twe, struct clnt_req, cc_rqst);
 
-	if ((acc->ts.tv_sec - REC_XPRT(xprt)->recv.ts.tv_sec) < acc->timeout)
-		return (false);
+		/* order dependent:  a reply or reset that cleared the flag
+		 * first is waiting to remove it, then releases the call.
+		 */
+		if (atomic_postclear_uint16_t_bits(&cc->cc_flags,
+						   CLNT_REQ_FLAG_EXPIRING)
+		    & CLNT_REQ_FLAG_EXPIRING)
+			atomic_inc_int32_t(&cc->cc_refcnt);
+		else
+			TAILQ_REMOVE(&expired, twe, twe_q);
+	}
+	pthread_spin_unlock(&sr_rec->ev_lock);
+
+	while ((twe = TAILQ_FIRST(&expired))) {
+		TAILQ_REMOVE(&expired, twe, twe_q);
+		cc = opr_containerof(twe, struct clnt_req, cc_rqst);
+		cc->cc_wpe.fun = svc_rqst_expire_task;
+		cc->cc_wpe.arg = NULL;
+		work_pool_submit(sr_rec->ev_pool, &cc->cc_wpe);
+	}
 
-	SVC_DESTROY(xprt);
-	acc->cleaned++;
-	return (true);
+	return (timeout_ms);
 }
 
-void authgss_ctx_gc_idle(void);
-
-static void
-svc_rqst_clean_idle(int timeout)
+/*
+ * Event on a transport, referenced by the lookup.  Returns the transport
+ * when its task should run, otherwise releases the reference.
+ */
+static inline struct rpc_dplx_rec *
+svc_rqst_xprt_event(struct rpc_dplx_rec *rec, uint32_t events)
 {
-	struct svc_rqst_clean_arg acc;
-	static mutex_t active_mtx = MUTEX_INITIALIZER;
-	static uint32_t active;
-
-	if (mutex_trylock(&active_mtx) != 0)
-		return;
+	uint16_t xp_flags;
 
-	if (active > 0)
-		goto unlock;
+	/* MUST handle flags after reference.
+	 * Although another task may unhook, the error is non-fatal.
+	 */
+	xp_flags = atomic_postclear_uint16_t_bits(&rec->xprt.xp_flags,
+						  SVC_XPRT_FLAG_ADDED);
 
-	++active;
+	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST |
+		TIRPC_DEBUG_FLAG_REFCNT,
+		"%s: %p fd %d xp_refcnt %" PRId32
+		" event %d",
+		__func__, rec, rec->xprt.xp_fd, rec->xprt.xp_refcnt,
+		events);
 
-#ifdef _HAVE_GSSAPI
-	/* trim gss context cache */
-	authgss_ctx_gc_idle();
-#endif /* _HAVE_GSSAPI */
+	if (rec->xprt.xp_refcnt > 1
+	 && (xp_flags & SVC_XPRT_FLAG_ADDED)
+	 && !(xp_flags & SVC_XPRT_FLAG_DESTROYED)
+	 && !(atomic_postset_uint16_t_bits(&rec->ioq.ioq_s.qflags,
+					   IOQ_FLAG_WORKING)
+	      & IOQ_FLAG_WORKING)) {
+		/* (idempotent) xp_flags and xp_refcnt are set atomic.
+		 * xp_refcnt need more than 1 (this event).
+		 */
+		rec->ev_events = events;
+		return (rec);
+	}
 
-	if (timeout <= 0)
-		goto unlock;
+	/* Do not return destroyed transports.
+	 * Probably log non-fatal "WARNING! already destroying!"
+	 */
+	SVC_RELEASE(&rec->xprt, SVC_RELEASE_FLAG_NONE);
+	return (NULL);
+}
 
-	/* trim xprts (not sorted, not aggressive [but self limiting]) */
-	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &acc.ts);
-	acc.timeout = timeout;
-	acc.cleaned = 0;
+/*
+ * Dispatch ready transports.  The first runs in this (hot) thread, after
+ * the remainder and the next event task are submitted.
+ *
+ * Each holds its event reference until its task runs, as
+ * svc_*_destroy_it() waits for IOQ_FLAG_WORKING.
+ */
+static inline void
+svc_rqst_dispatch(struct svc_rqst_rec *sr_rec, struct rpc_dplx_rec *rec,
+		  struct work_pool_entry **wpes, int n_wpes)
+{
+	/* submit another task to handle events in order */
+	atomic_inc_int32_t(&sr_rec->ev_refcnt);
+	wpes[n_wpes++] = &sr_rec->ev_wpe;
 
-	svc_xprt_foreach(svc_rqst_clean_func, (void *)&acc);
+	/* one pool lock for all of the ready transports.
+	 * ev_wpe is last, so the next event task cannot reuse wpes
+	 * before the pool lock is released.
+	 */
+	work_pool_submit_near(sr_rec->ev_pool, wpes, n_wpes,
+			      sr_rec->ev_node, sr_rec->ev_cpu);
 
- unlock:
-	--active;
-	mutex_unlock(&active_mtx);
-	return;
+	/* in most cases have only one event, use this hot thread */
+	svc_rqst_xprt_task(&rec->ioq.ioq_wpe);
 }
 
 #ifdef TIRPC_EPOLL
@@ -856,20 +1586,18 @@ static struct rpc_dplx_rec *
 svc_rqst_epoll_event(struct svc_rqst_rec *sr_rec, struct epoll_event *ev)
 {
 	SVCXPRT *xprt;
-	struct rpc_dplx_rec *rec;
-	uint16_t xp_flags;
 
-	if (unlikely(ev->data.fd == sr_rec->sv[1])) {
+	if (unlikely(ev->data.fd == sr_rec->ev_fd)) {
 		/* signalled -- there was a wakeup on ctrl_ev (see
 		 * top-of-loop) */
 		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
 			"%s: fd %d wakeup (sr_rec %p)",
-			__func__, sr_rec->sv[1],
+			__func__, sr_rec->ev_fd,
 			sr_rec);
-		(void)consume_ev_sig_nb(sr_rec->sv[1]);
+		consume_ev_sig_nb(sr_rec);
 		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
 			"%s: fd %d after consume sig (sr_rec %p)",
-			__func__, sr_rec->sv[1],
+			__func__, sr_rec->ev_fd,
 			sr_rec);
 		return (NULL);
 	}
@@ -882,38 +1610,7 @@ svc_rqst_epoll_event(struct svc_rqst_rec *sr_rec, struct epoll_event *ev)
 		return (NULL);
 	}
 	/* At this point, we have a ref on the xprt, and know it's valid */
-	rec = REC_XPRT(xprt);
-
-	/* MUST handle flags after reference.
-	 * Although another task may unhook, the error is non-fatal.
-	 */
-	xp_flags = atomic_postclear_uint16_t_bits(&rec->xprt.xp_flags,
-						  SVC_XPRT_FLAG_ADDED);
-
-	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST |
-		TIRPC_DEBUG_FLAG_REFCNT,
-		"%s: %p fd %d xp_refcnt %" PRId32
-		" event %d",
-		__func__, rec, rec->xprt.xp_fd, rec->xprt.xp_refcnt,
-		ev->events);
-
-	if (rec->xprt.xp_refcnt > 1
-	 && (xp_flags & SVC_XPRT_FLAG_ADDED)
-	 && !(xp_flags & SVC_XPRT_FLAG_DESTROYED)
-	 && !(atomic_postset_uint16_t_bits(&rec->ioq.ioq_s.qflags,
-					   IOQ_FLAG_WORKING)
-	      & IOQ_FLAG_WORKING)) {
-		/* (idempotent) xp_flags and xp_refcnt are set atomic.
-		 * xp_refcnt need more than 1 (this event).
-		 */
-		return (rec);
-	}
-
-	/* Do not return destroyed transports.
-	 * Probably log non-fatal "WARNING! already destroying!"
-	 */
-	SVC_RELEASE(&rec->xprt, SVC_RELEASE_FLAG_NONE);
-	return (NULL);
+	return (svc_rqst_xprt_event(REC_XPRT(xprt), ev->events));
 }
 
 /*
@@ -922,7 +1619,9 @@ svc_rqst_epoll_event(struct svc_rqst_rec *sr_rec, struct epoll_event *ev)
 static inline bool
 svc_rqst_epoll_events(struct svc_rqst_rec *sr_rec, int n_events)
 {
+	struct work_pool_entry **wpes = sr_rec->ev_u.epoll.wpes;
 	struct rpc_dplx_rec *rec = NULL;
+	int n_wpes = 0;
 	int ix = 0;
 
 	while (ix < n_events) {
@@ -944,65 +1643,73 @@ svc_rqst_epoll_events(struct svc_rqst_rec *sr_rec, int n_events)
 			continue;
 
 		rec->ioq.ioq_wpe.fun = svc_rqst_xprt_task;
-		work_pool_submit(&svc_work_pool, &(rec->ioq.ioq_wpe));
+		wpes[n_wpes++] = &(rec->ioq.ioq_wpe);
 	}
 
-	/* submit another task to handle events in order */
-	atomic_inc_int32_t(&sr_rec->ev_refcnt);
-	work_pool_submit(&svc_work_pool, &sr_rec->ev_wpe);
+	svc_rqst_dispatch(sr_rec, rec, wpes, n_wpes);
+	return true;
+}
 
-	/* in most cases have only one event, use this hot thread */
-	rec->ioq.ioq_wpe.fun = svc_rqst_xprt_task;
-	svc_rqst_xprt_task(&(rec->ioq.ioq_wpe));
+static inline uint64_t
+svc_rqst_busy_now(void)
+{
+	struct timespec ts;
 
-	/* failsafe idle processing after work task */
-	if (atomic_postclear_uint32_t_bits(&wakeups, ~SVC_RQST_WAKEUPS)
-	    > SVC_RQST_WAKEUPS) {
-		svc_rqst_clean_idle(__svc_params->idle_timeout);
-	}
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
 
-	return true;
+/*
+ * Returns true while the busy poll window is open.  A window ending
+ * without events halves the next, down to an eighth of the maximum.
+ */
+static inline bool
+svc_rqst_busy_polling(struct svc_rqst_rec *sr_rec)
+{
+	if (!sr_rec->ev_busy_until)
+		return false;
+	if (svc_rqst_busy_now() < sr_rec->ev_busy_until)
+		return true;
+
+	sr_rec->ev_busy_until = 0;
+	sr_rec->ev_busy_window = MAX(sr_rec->ev_busy_window / 2,
+				     sr_rec->ev_busy_max / 8);
+	atomic_inc_uint64_t(&sr_rec->ev_stats.ev_busy_misses);
+	return false;
+}
+
+/*
+ * Events arrived:  (re)open the window, before the loop is resubmitted.
+ */
+static inline void
+svc_rqst_busy_arm(struct svc_rqst_rec *sr_rec, bool polling)
+{
+	if (!sr_rec->ev_busy_max)
+		return;
+	if (polling) {
+		sr_rec->ev_busy_window = sr_rec->ev_busy_max;
+		atomic_inc_uint64_t(&sr_rec->ev_stats.ev_busy_hits);
+	}
+	sr_rec->ev_busy_until = svc_rqst_busy_now() + sr_rec->ev_busy_window;
 }
 
 static inline bool
 svc_rqst_epoll_loop(struct svc_rqst_rec *sr_rec)
 {
-	struct clnt_req *cc;
-	struct opr_rbtree_node *n;
-	struct timespec ts;
+	bool polling;
 	int timeout_ms;
-	int expire_ms;
 	int n_events;
 
 	for (;;) {
-		timeout_ms = SVC_RQST_TIMEOUT_MS;
-
-		/* coarse nsec, not system time */
-		(void)clock_gettime(CLOCK_MONOTONIC_FAST, &ts);
-		expire_ms = timespec_ms(&ts);
+		/* signals may be coalesced (see consume_ev_sig_nb) */
+		if (unlikely(sr_rec->ev_flags & SVC_RQST_FLAG_SHUTDOWN))
+			return true;
 
 		/* before epoll_wait will accumulate events during scan */
-		mutex_lock(&sr_rec->ev_lock);
-		while ((n = opr_rbtree_first(&sr_rec->call_expires))) {
-			cc = opr_containerof(n, struct clnt_req, cc_rqst);
-
-			if (cc->cc_expire_ms > expire_ms) {
-				timeout_ms = cc->cc_expire_ms - expire_ms;
-				break;
-			}
-
-			/* order dependent */
-			atomic_clear_uint16_t_bits(&cc->cc_flags,
-						   CLNT_REQ_FLAG_EXPIRING);
-			opr_rbtree_remove(&sr_rec->call_expires, &cc->cc_rqst);
-			cc->cc_expire_ms = 0;	/* atomic barrier(s) */
-
-			atomic_inc_uint32_t(&cc->cc_refcnt);
-			cc->cc_wpe.fun = svc_rqst_expire_task;
-			cc->cc_wpe.arg = NULL;
-			work_pool_submit(&svc_work_pool, &cc->cc_wpe);
-		}
-		mutex_unlock(&sr_rec->ev_lock);
+		timeout_ms = svc_rqst_expire_events(sr_rec);
+		polling = svc_rqst_busy_polling(sr_rec);
+		if (polling)
+			timeout_ms = 0;
 
 		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
 			"%s: epoll_fd %d before epoll_wait (%d)",
@@ -1024,7 +1731,7 @@ svc_rqst_epoll_loop(struct svc_rqst_rec *sr_rec)
 			return true;
 		}
 		if (n_events > 0) {
-			atomic_add_uint32_t(&wakeups, n_events);
+			svc_rqst_busy_arm(sr_rec, polling);
 
 			if (svc_rqst_epoll_events(sr_rec, n_events))
 				return false;
@@ -1032,7 +1739,6 @@ svc_rqst_epoll_loop(struct svc_rqst_rec *sr_rec)
 		}
 		if (!n_events) {
 			/* timed out (idle) */
-			atomic_inc_uint32_t(&wakeups);
 			continue;
 		}
 		n_events = errno;
@@ -1048,6 +1754,196 @@ svc_rqst_epoll_loop(struct svc_rqst_rec *sr_rec)
 }
 #endif
 
+#if defined(TIRPC_IO_URING)
+static struct rpc_dplx_rec *
+svc_rqst_uring_event(struct svc_rqst_rec *sr_rec, struct io_uring_cqe *cqe)
+{
+	struct svc_rqst_uring *ring = &sr_rec->ev_u.io_uring.ring;
+	struct rpc_dplx_rec *rec;
+	SVCXPRT *xprt;
+	int fd;
+
+	if (unlikely(cqe->user_data == SVC_RQST_URING_CTRL)) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: fd %d wakeup (sr_rec %p) res %d",
+			__func__, sr_rec->ev_fd,
+			sr_rec, cqe->res);
+		if (cqe->res > 0)
+			consume_ev_sig_nb(sr_rec);
+		(void)svc_rqst_uring_ctrl(ring, sr_rec->ev_fd);
+		return (NULL);
+	}
+
+	if (cqe->user_data & SVC_RQST_URING_NOEV)
+		return (NULL);
+
+	if (cqe->res == -ECANCELED) {
+		/* cancelled by unhook */
+		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: user_data %" PRIx64 " cancelled",
+			__func__, (uint64_t)cqe->user_data);
+		return (NULL);
+	}
+
+	fd = (int)(uint32_t)cqe->user_data;
+	xprt = svc_xprt_lookup(fd, NULL);
+	if (!xprt) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: fd %d no associated xprt",
+			__func__, fd);
+		return (NULL);
+	}
+	/* At this point, we have a ref on the xprt, and know it's valid */
+	rec = REC_XPRT(xprt);
+
+	if (unlikely(rec->ev_u.io_uring.user_data != cqe->user_data)) {
+		/* poll of a previous transport using this fd */
+		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		return (NULL);
+	}
+	if (unlikely(cqe->res < 0)) {
+		/* failed (not cancelled), so no longer armed */
+		__warnx(TIRPC_DEBUG_FLAG_WARN,
+			"%s: fd %d poll failed (%d), rearming",
+			__func__, fd, -cqe->res);
+		atomic_clear_uint16_t_bits(&xprt->xp_flags,
+					   SVC_XPRT_FLAG_ADDED);
+		if (unlikely(svc_rqst_rearm_events(xprt)))
+			SVC_DESTROY(xprt);
+		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		return (NULL);
+	}
+	return (svc_rqst_xprt_event(rec, cqe->res));
+}
+
+/*
+ * not locked
+ */
+static inline bool
+svc_rqst_uring_events(struct svc_rqst_rec *sr_rec, int n_events)
+{
+	struct work_pool_entry **wpes = sr_rec->ev_u.io_uring.wpes;
+	struct rpc_dplx_rec *rec = NULL;
+	int n_wpes = 0;
+	int ix = 0;
+
+	while (ix < n_events) {
+		rec = svc_rqst_uring_event(sr_rec,
+					   &(sr_rec->ev_u.io_uring.events[ix++]));
+		if (rec)
+			break;
+	}
+
+	if (!rec) {
+		/* continue waiting for events with this task */
+		return false;
+	}
+
+	while (ix < n_events) {
+		struct rpc_dplx_rec *rec = svc_rqst_uring_event(sr_rec,
+					    &(sr_rec->ev_u.io_uring.events[ix++]));
+		if (!rec)
+			continue;
+
+		rec->ioq.ioq_wpe.fun = svc_rqst_xprt_task;
+		wpes[n_wpes++] = &(rec->ioq.ioq_wpe);
+	}
+
+	svc_rqst_dispatch(sr_rec, rec, wpes, n_wpes);
+	return true;
+}
+
+/*
+ * Copy completions out of the ring, so the polls they report can be
+ * resubmitted into a ring that is no longer full.
+ */
+static inline int
+svc_rqst_uring_reap(struct svc_rqst_rec *sr_rec)
+{
+	struct svc_rqst_uring *ring = &sr_rec->ev_u.io_uring.ring;
+	uint32_t head = *ring->cq_khead;
+	uint32_t tail = atomic_fetch_uint32_t(ring->cq_ktail);
+	int n_events = 0;
+
+	while (head != tail
+	       && n_events < sr_rec->ev_u.io_uring.max_events) {
+		sr_rec->ev_u.io_uring.events[n_events++] =
+			ring->cqes[head++ & ring->cq_mask];
+	}
+	atomic_store_uint32_t(ring->cq_khead, head);
+	return (n_events);
+}
+
+static inline bool
+svc_rqst_uring_loop(struct svc_rqst_rec *sr_rec)
+{
+	struct svc_rqst_uring *ring = &sr_rec->ev_u.io_uring.ring;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	uint32_t to_submit;
+	int timeout_ms;
+	int n_events;
+	int code;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.ts = (uintptr_t)&ts;
+
+	for (;;) {
+		/* signals may be coalesced (see consume_ev_sig_nb) */
+		if (unlikely(sr_rec->ev_flags & SVC_RQST_FLAG_SHUTDOWN))
+			return true;
+
+		/* before io_uring_enter will accumulate events during scan */
+		timeout_ms = svc_rqst_expire_events(sr_rec);
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+
+		/* polls queued since the last wait (rearms, hooks, unhooks)
+		 * are submitted together with this wait.
+		 */
+		mutex_lock(&ring->sq_lock);
+		to_submit = svc_rqst_uring_unsubmitted(ring);
+		ring->waiting = true;
+		mutex_unlock(&ring->sq_lock);
+
+		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: ring_fd %d before io_uring_enter (%d) submit %"
+			PRIu32,
+			__func__, ring->ring_fd, timeout_ms, to_submit);
+
+		code = io_uring_enter_wr(ring->ring_fd, to_submit, 1,
+					 IORING_ENTER_GETEVENTS |
+					 IORING_ENTER_EXT_ARG,
+					 &arg, sizeof(arg));
+		code = (code < 0) ? errno : 0;
+
+		mutex_lock(&ring->sq_lock);
+		ring->waiting = false;
+		mutex_unlock(&ring->sq_lock);
+
+		if (unlikely(sr_rec->ev_flags & SVC_RQST_FLAG_SHUTDOWN)) {
+			__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+				"%s: ring_fd %d io_uring_enter shutdown (%d)",
+				__func__, ring->ring_fd, code);
+			return true;
+		}
+		if (code && code != ETIME && code != EINTR && code != EBUSY) {
+			__warnx(TIRPC_DEBUG_FLAG_WARN,
+				"%s: ring_fd %d io_uring_enter failed (%d)",
+				__func__, ring->ring_fd, code);
+			return true;
+		}
+
+		n_events = svc_rqst_uring_reap(sr_rec);
+		if (n_events > 0) {
+			if (svc_rqst_uring_events(sr_rec, n_events))
+				return false;
+			continue;
+		}
+	}
+}
+#endif /* TIRPC_IO_URING */
+
 /*
  * No locking, "there can be only one"
  */
@@ -1068,6 +1964,23 @@ svc_rqst_run_task(struct work_pool_entry *wpe)
 			mem_free(sr_rec->ev_u.epoll.events,
 				 sr_rec->ev_u.epoll.max_events *
 				 sizeof(struct epoll_event));
+			mem_free(sr_rec->ev_u.epoll.wpes,
+				 sr_rec->ev_u.epoll.max_events *
+				 sizeof(struct work_pool_entry *));
+		}
+		break;
+#endif
+#if defined(TIRPC_IO_URING)
+	case SVC_EVENT_IO_URING:
+		finished = svc_rqst_uring_loop(sr_rec);
+		if (finished) {
+			svc_rqst_uring_destroy(&sr_rec->ev_u.io_uring.ring);
+			mem_free(sr_rec->ev_u.io_uring.events,
+				 sr_rec->ev_u.io_uring.max_events *
+				 sizeof(struct io_uring_cqe));
+			mem_free(sr_rec->ev_u.io_uring.wpes,
+				 sr_rec->ev_u.io_uring.max_events *
+				 sizeof(struct work_pool_entry *));
 		}
 		break;
 #endif
@@ -1105,7 +2018,7 @@ svc_rqst_thrd_signal(uint32_t chan_id, uint32_t flags)
 		return (ENOENT);
 	}
 
-	ev_sig(sr_rec->sv[0], flags);	/* send wakeup */
+	ev_sig(sr_rec, flags);	/* send wakeup */
 
 	__warnx(TIRPC_DEBUG_FLAG_ERROR,
 		"%s: signalled evchan %d",
@@ -1114,7 +2027,28 @@ svc_rqst_thrd_signal(uint32_t chan_id, uint32_t flags)
 	return (0);
 }
 
-static int
+int
+svc_rqst_get_stats(uint32_t chan_id, struct svc_rqst_stats *stats)
+{
+	struct svc_rqst_rec *sr_rec;
+
+	sr_rec = svc_rqst_lookup_chan(chan_id);
+	if (!sr_rec)
+		return (ENOENT);
+
+	stats->ev_sigs = atomic_fetch_uint64_t(&sr_rec->ev_stats.ev_sigs);
+	stats->ev_sigs_coalesced =
+		atomic_fetch_uint64_t(&sr_rec->ev_stats.ev_sigs_coalesced);
+	stats->ev_busy_hits =
+		atomic_fetch_uint64_t(&sr_rec->ev_stats.ev_busy_hits);
+	stats->ev_busy_misses =
+		atomic_fetch_uint64_t(&sr_rec->ev_stats.ev_busy_misses);
+
+	svc_rqst_release(sr_rec);
+	return (0);
+}
+
+int
 svc_rqst_delete_evchan(uint32_t chan_id)
 {
 	struct svc_rqst_rec *sr_rec;
@@ -1125,7 +2059,7 @@ svc_rqst_delete_evchan(uint32_t chan_id)
 		return (ENOENT);
 	}
 	atomic_set_uint16_t_bits(&sr_rec->ev_flags, SVC_RQST_FLAG_SHUTDOWN);
-	ev_sig(sr_rec->sv[0], SVC_RQST_FLAG_SHUTDOWN);
+	ev_sig(sr_rec, SVC_RQST_FLAG_SHUTDOWN);
 
 	svc_rqst_release(sr_rec);
 	return (code);
@@ -1135,8 +2069,20 @@ void
 svc_rqst_shutdown(void)
 {
 	uint32_t channels = svc_rqst_set.max_id;
+	struct svc_rqst_rec *sr_rec;
 
 	while (channels > 0) {
 		svc_rqst_delete_evchan(--channels);
 	}
+
+	/* release dedicated workers after their event channels */
+	for (channels = 0; channels < svc_rqst_set.max_id; channels++) {
+		sr_rec = &svc_rqst_set.srr[channels];
+		if (sr_rec->ev_pool_owned) {
+			work_pool_shutdown(sr_rec->ev_pool);
+			mem_free(sr_rec->ev_pool, sizeof(struct work_pool));
+			sr_rec->ev_pool_owned = false;
+		}
+		sr_rec->ev_pool = NULL;
+	}
 }
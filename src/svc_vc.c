@@ -63,7 +63,6 @@
 #include <getpeereid.h>
 
 #include <rpc/types.h>
-#include <misc/city.h>
 #include <misc/portable.h>
 #include <misc/timespec.h>
 #include <rpc/clnt.h>
@@ -117,6 +116,9 @@ static void
 svc_vc_xprt_free(struct svc_vc_xprt *xd)
 {
 	XDR_DESTROY(xd->sx_dr.ioq.xdrs);
+	if (xd->sx_rbuf)
+		mem_free(xd->sx_rbuf, xd->sx_rsize);
+	svc_ioq_zerocopy_destroy(&xd->sx_zcq);
 	rpc_dplx_rec_destroy(&xd->sx_dr);
 	mem_free(xd, sizeof(struct svc_vc_xprt));
 }
@@ -129,6 +131,7 @@ svc_vc_xprt_zalloc(void)
 	/* Init SVCXPRT locks, etc */
 	rpc_dplx_rec_init(&xd->sx_dr);
 	xdr_ioq_setup(&xd->sx_dr.ioq);
+	poolq_head_setup(&xd->sx_zcq);
 	return (xd);
 }
 
@@ -429,6 +432,10 @@ svc_vc_rendezvous(SVCXPRT *xprt)
 #if defined(TIRPC_EPOLL)
 			case SVC_EVENT_EPOLL:
 				break;
+#endif
+#if defined(TIRPC_IO_URING)
+			case SVC_EVENT_IO_URING:
+				break;
 #endif
 			default:
 				abort();	/* XXX */
@@ -534,11 +541,8 @@ svc_vc_destroy_task(struct work_pool_entry *wpe)
 		"%s() %p fd %d xp_refcnt %" PRId32,
 		__func__, rec, rec->xprt.xp_fd, rec->xprt.xp_refcnt);
 
-	if (rec->xprt.xp_refcnt) {
-		/* instead of nanosleep */
-		work_pool_submit(&svc_work_pool, &(rec->ioq.ioq_wpe));
+	if (!svc_xprt_retired(&rec->xprt))
 		return;
-	}
 
 	xp_flags = atomic_postclear_uint16_t_bits(&rec->xprt.xp_flags,
 						  SVC_XPRT_FLAG_CLOSE);
@@ -566,6 +570,9 @@ static void
 svc_vc_unlink_it(SVCXPRT *xprt, u_int flags, const char *tag, const int line)
 {
 	svc_rqst_xprt_unregister(xprt, flags);
+
+	/* no more POLLOUT to resume parked output */
+	svc_ioq_write_abort(xprt);
 }
 
 static void
@@ -656,30 +663,265 @@ svc_vc_stat(SVCXPRT *xprt)
 	return (XPRT_IDLE);
 }
 
+/*
+ * Find the request being assembled, or start a new one.
+ */
+static inline struct xdr_ioq *
+svc_vc_recv_ioq(struct rpc_dplx_rec *rec)
+{
+	struct svc_vc_xprt *xd = VC_DR(rec);
+	struct poolq_entry *have;
+	struct xdr_ioq *xioq;
+
+	have = TAILQ_LAST(&rec->ioq.ioq_uv.uvqh.qh, poolq_head_s);
+	if (have)
+		return (_IOQ(have));
+
+	xioq = xdr_ioq_create(xd->sx_dr.pagesz, xd->sx_dr.maxrec,
+			      UIO_FLAG_BUFQ);
+	(rec->ioq.ioq_uv.uvqh.qcount)++;
+	TAILQ_INSERT_TAIL(&rec->ioq.ioq_uv.uvqh.qh, &xioq->ioq_s, q);
+	return (xioq);
+}
+
+/*
+ * SVC_FLAG_VC_DRAIN receive
+ *
+ * Reads as much as the socket holds into a per-transport staging buffer,
+ * and splits it into record fragments.  Every complete record but the
+ * last is handed to the work pool; the last is decoded inline, after
+ * the events are re-armed on EAGAIN.
+ *
+ * Fragment bodies are copied out as soon as they are seen, so only a
+ * partial header remains staged between reads.  Bodies at least as large
+ * as the staging buffer are read directly into their buffer.
+ */
+#define SVC_VC_DRAIN_BUFSZ (64 * 1024)
+#define SVC_VC_DRAIN_MAX 64	/* records per event, then re-arm */
+
+static void
+svc_vc_request_task(struct work_pool_entry *wpe)
+{
+	struct xdr_ioq *xioq = opr_containerof(wpe, struct xdr_ioq, ioq_wpe);
+	SVCXPRT *xprt = (SVCXPRT *)xioq->xdrs[0].x_lib[1];
+
+	if (likely(!(xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)))
+		(void)__svc_params->request_cb(xprt, xioq->xdrs);
+	else
+		xdr_ioq_destroy(xioq, xioq->ioq_s.qsize);
+
+	/* Release the ref taken on dispatch */
+	SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+}
+
+static inline void
+svc_vc_recv_ready(SVCXPRT *xprt, struct xdr_ioq *xioq,
+		  struct xdr_ioq **ready)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct xdr_ioq *prev = *ready;
+
+	(rec->ioq.ioq_uv.uvqh.qcount)--;
+	TAILQ_REMOVE(&rec->ioq.ioq_uv.uvqh.qh, &xioq->ioq_s, q);
+	xdr_ioq_reset(xioq, 0);
+	*ready = xioq;
+
+	if (!prev)
+		return;
+
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+	prev->xdrs[0].x_lib[1] = (void *)xprt;
+	prev->ioq_wpe.fun = svc_vc_request_task;
+	work_pool_submit(svc_rqst_work_pool(xprt), &prev->ioq_wpe);
+}
+
+static enum xprt_stat
+svc_vc_recv_drain(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct svc_vc_xprt *xd = VC_DR(rec);
+	struct xdr_ioq *ready = NULL;
+	struct xdr_ioq *xioq = NULL;
+	struct xdr_ioq_uv *uv = NULL;
+	uint32_t header;
+	ssize_t rlen;
+	u_int count = 0;
+	u_int flags;
+	u_int len;
+	u_int pos;
+	u_int n;
+	int code;
+
+	if (unlikely(!xd->sx_rbuf)) {
+		xd->sx_rsize = MAX(xd->sx_dr.recvsz, SVC_VC_DRAIN_BUFSZ);
+		xd->sx_rbuf = mem_alloc(xd->sx_rsize);
+	}
+
+	if (xd->sx_fbtbc) {
+		/* fragment left over from a previous event */
+		xioq = svc_vc_recv_ioq(rec);
+		uv = IOQ_(TAILQ_LAST(&xioq->ioq_uv.uvqh.qh, poolq_head_s));
+	}
+
+	while (count < SVC_VC_DRAIN_MAX) {
+		/* stop reading while output is over budget */
+		if (unlikely(count && svc_ioq_pause(xprt)))
+			break;
+
+		if ((u_int)xd->sx_fbtbc >= xd->sx_rsize) {
+			/* nothing staged while a body is pending */
+			rlen = recv(xprt->xp_fd, uv->v.vio_tail, xd->sx_fbtbc,
+				    MSG_DONTWAIT);
+		} else {
+			rlen = recv(xprt->xp_fd, xd->sx_rbuf + xd->sx_rlen,
+				    xd->sx_rsize - xd->sx_rlen, MSG_DONTWAIT);
+		}
+
+		if (unlikely(rlen < 0)) {
+			code = errno;
+
+			if (code == EAGAIN || code == EWOULDBLOCK)
+				break;
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: %p fd %d recv errno %d (will set dead)",
+				__func__, xprt, xprt->xp_fd, code);
+			goto dead;
+		}
+
+		if (unlikely(!rlen)) {
+			__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+				"%s: %p fd %d recv closed (will set dead)",
+				__func__, xprt, xprt->xp_fd);
+			goto dead;
+		}
+
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: %p fd %d recv %zd, need %" PRIu32 ", staged %u",
+			__func__, xprt, xprt->xp_fd, rlen, xd->sx_fbtbc,
+			xd->sx_rlen);
+
+		if ((u_int)xd->sx_fbtbc >= xd->sx_rsize) {
+			uv->v.vio_tail += rlen;
+			xd->sx_fbtbc -= rlen;
+			if (!xd->sx_fbtbc
+			 && !(uv->u.uio_flags & UIO_FLAG_MORE)) {
+				svc_vc_recv_ready(xprt, xioq, &ready);
+				count++;
+			}
+			continue;
+		}
+
+		len = xd->sx_rlen + rlen;
+		pos = 0;
+
+		while (pos < len) {
+			if (!xd->sx_fbtbc) {
+				if (len - pos < BYTES_PER_XDR_UNIT)
+					break;
+
+				memcpy(&header, xd->sx_rbuf + pos,
+				       BYTES_PER_XDR_UNIT);
+				pos += BYTES_PER_XDR_UNIT;
+				header = ntohl(header);
+				flags = UIO_FLAG_FREE | UIO_FLAG_MORE;
+
+				if (header & LAST_FRAG) {
+					header &= (~LAST_FRAG);
+					flags = UIO_FLAG_FREE;
+				}
+
+				if (unlikely(!header)) {
+					__warnx(TIRPC_DEBUG_FLAG_ERROR,
+						"%s: %p fd %d fragment is zero (will set dead)",
+						__func__, xprt, xprt->xp_fd);
+					goto dead;
+				}
+				xd->sx_fbtbc = header;
+
+				/* one buffer per fragment */
+				xioq = svc_vc_recv_ioq(rec);
+				uv = xdr_ioq_uv_bufq_create(xd->sx_fbtbc,
+							    flags);
+				(xioq->ioq_uv.uvqh.qcount)++;
+				TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh,
+						  &uv->uvq, q);
+			}
+
+			n = MIN((u_int)xd->sx_fbtbc, len - pos);
+			memcpy(uv->v.vio_tail, xd->sx_rbuf + pos, n);
+			uv->v.vio_tail += n;
+			xd->sx_fbtbc -= n;
+			pos += n;
+
+			if (!xd->sx_fbtbc
+			 && !(uv->u.uio_flags & UIO_FLAG_MORE)) {
+				svc_vc_recv_ready(xprt, xioq, &ready);
+				count++;
+			}
+		}
+
+		/* keep any partial header for the next read */
+		xd->sx_rlen = len - pos;
+		if (xd->sx_rlen)
+			memmove(xd->sx_rbuf, xd->sx_rbuf + pos, xd->sx_rlen);
+	}
+
+	if (unlikely(svc_rqst_rearm_events(xprt))) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+			__func__, xprt, xprt->xp_fd);
+		goto dead;
+	}
+
+	if (!ready)
+		return SVC_STAT(xprt);
+
+	return (__svc_params->request_cb(xprt, ready->xdrs));
+
+dead:
+	if (ready)
+		xdr_ioq_destroy(ready, ready->ioq_s.qsize);
+	SVC_DESTROY(xprt);
+	return SVC_STAT(xprt);
+}
+
 static enum xprt_stat
 svc_vc_recv(SVCXPRT *xprt)
 {
 	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
 	struct svc_vc_xprt *xd = VC_DR(rec);
-	struct poolq_entry *have;
 	struct xdr_ioq_uv *uv;
 	struct xdr_ioq *xioq;
 	ssize_t rlen;
 	u_int flags;
 	int code;
 
+	if (unlikely(xd->sx_zerocopy > 0)) {
+		/* MSG_ZEROCOPY completions also wake this transport */
+		if (xd->sx_zcq.qcount)
+			svc_ioq_zerocopy_reap(xprt);
+
+		if (!(__svc_params->flags & SVC_FLAG_VC_DRAIN)
+		 && recv(xprt->xp_fd, &code, 1, MSG_PEEK | MSG_DONTWAIT) < 0
+		 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			/* nothing to read, avoid blocking below */
+			if (unlikely(svc_rqst_rearm_events(xprt))) {
+				__warnx(TIRPC_DEBUG_FLAG_ERROR,
+					"%s: %p fd %d svc_rqst_rearm_events failed (will set dead)",
+					__func__, xprt, xprt->xp_fd);
+				SVC_DESTROY(xprt);
+			}
+			return SVC_STAT(xprt);
+		}
+	}
+
+	if (__svc_params->flags & SVC_FLAG_VC_DRAIN)
+		return (svc_vc_recv_drain(xprt));
+
 	/* no need for locking, only one svc_rqst_xprt_task() per event.
 	 * depends upon svc_rqst_rearm_events() for ordering.
 	 */
-	have = TAILQ_LAST(&rec->ioq.ioq_uv.uvqh.qh, poolq_head_s);
-	if (!have) {
-		xioq = xdr_ioq_create(xd->sx_dr.pagesz, xd->sx_dr.maxrec,
-				      UIO_FLAG_BUFQ);
-		(rec->ioq.ioq_uv.uvqh.qcount)++;
-		TAILQ_INSERT_TAIL(&rec->ioq.ioq_uv.uvqh.qh, &xioq->ioq_s, q);
-	} else {
-		xioq = _IOQ(have);
-	}
+	xioq = svc_vc_recv_ioq(rec);
 
 	if (!xd->sx_fbtbc) {
 		rlen = recv(xprt->xp_fd, &xd->sx_fbtbc, BYTES_PER_XDR_UNIT,
@@ -733,7 +975,7 @@ svc_vc_recv(SVCXPRT *xprt)
 		}
 
 		/* one buffer per fragment */
-		uv = xdr_ioq_uv_create(xd->sx_fbtbc, flags);
+		uv = xdr_ioq_uv_bufq_create(xd->sx_fbtbc, flags);
 		(xioq->ioq_uv.uvqh.qcount)++;
 		TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
 	} else {
@@ -848,19 +1090,6 @@ svc_vc_decode(struct svc_req *req)
 	return SVC_STAT(xprt);
 }
 
-static void
-svc_vc_checksum(struct svc_req *req, void *data, size_t length)
-{
-	req->rq_cksum =
-#if 1
-	/* CithHash64 is -substantially- faster than crc32c from FreeBSD
-	 * SCTP, so prefer it until fast crc32c bests it */
-		CityHash64WithSeed(data, MIN(256, length), 103);
-#else
-		calculate_crc32c(0, data, MIN(256, length));
-#endif
-}
-
 static enum xprt_stat
 svc_vc_reply(struct svc_req *req)
 {
@@ -874,11 +1103,12 @@ svc_vc_reply(struct svc_req *req)
 	 * Nb, we should probably use getpagesize() on Unix.  Need
 	 * an equivalent for Windows.
 	 */
-	xioq = xdr_ioq_create(RPC_MAXDATA_DEFAULT,
-			      __svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT,
-			      (req->rq_msg.cb_cred.oa_flavor == RPCSEC_GSS)
-			      ? UIO_FLAG_REALLOC | UIO_FLAG_FREE
-			      : UIO_FLAG_FREE);
+	xioq = xdr_ioq_create_cached(
+		RPC_MAXDATA_DEFAULT,
+		__svc_params->ioq.send_max + RPC_MAXDATA_DEFAULT,
+		(req->rq_msg.cb_cred.oa_flavor == RPCSEC_GSS)
+		? UIO_FLAG_REALLOC | UIO_FLAG_FREE
+		: UIO_FLAG_FREE);
 
 	if (!xdr_reply_encode(xioq->xdrs, &req->rq_msg)) {
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
@@ -919,7 +1149,7 @@ svc_vc_override_ops(SVCXPRT *xprt, SVCXPRT *rendezvous)
 		ops.xp_stat = svc_vc_stat;
 		ops.xp_decode = svc_vc_decode;
 		ops.xp_reply = svc_vc_reply;
-		ops.xp_checksum = svc_vc_checksum;
+		ops.xp_checksum = svc_cksum;
 		ops.xp_unlink = svc_vc_unlink_it;
 		ops.xp_destroy = svc_vc_destroy_it;
 		ops.xp_control = svc_vc_control;
@@ -37,9 +37,11 @@
 #include <rpc/types.h>
 #include <misc/portable.h>
 #include <rpc/rpc.h>
+#include <misc/timespec.h>
 #include "rpc_com.h"
 #include "svc_internal.h"
 #include "svc_xprt.h"
+#include "svc_epoch.h"
 
 /**
  * @file svc_xprt.c
@@ -54,18 +56,35 @@
  * close and delete (for example) given an existing xprt handle
  * are O(1) without any ordered or hashed representation.
  *
+ * Lookups of existing transports use a table indexed by fd instead,
+ * without locks:  the tree partition lock orders publishing in the
+ * table, and transports are freed only after an epoch has passed
+ * since they were unreferenced and unpublished (svc_xprt_retired).
+ *
+ * Transports in the tree are also on an idle timer wheel, keyed on their
+ * last receive.  The reaper thread re-places those that have received
+ * since, so the receive path only updates recv.ts, and reaping is
+ * O(expired) off the request threads.
+ *
  * @note currently static sizes
  *	partitions should be largish prime, relative to connections.
  *	no cache slots, as rpc_dplx_rec has fd_node for direct access.
+ *	fds beyond the table (RLIMIT_NOFILE, at most SVC_XPRT_FD_MAX)
+ *	use the tree.
  */
 
 #define SVC_XPRT_PARTITIONS 193
+#define SVC_XPRT_FD_MAX (1 << 20)
+#define SVC_XPRT_REAP_MS 1000	/* longest reaper wait */
+#define SVC_XPRT_DEFER_MS 4	/* reaper wait while frees are deferred */
 
 static bool initialized;
 
 struct svc_xprt_fd {
 	mutex_t lock;
 	struct rbtree_x xt;
+	struct rpc_dplx_rec **fds;	/* published transports by fd */
+	int nfds;
 	uint32_t connections;
 };
 
@@ -79,6 +98,20 @@ static struct svc_xprt_fd svc_xprt_fd = {
 	}			/* xt */
 };
 
+struct svc_xprt_idle {
+	mutex_t mtx;
+	cond_t cv;
+	struct timer_wheel tw;	/* by last receive + idle_timeout */
+	pthread_t reaper;
+	bool running;		/* reaper started */
+	bool shutdown;
+};
+
+static struct svc_xprt_idle svc_xprt_idle = {
+	.mtx = MUTEX_INITIALIZER,
+	.cv = PTHREAD_COND_INITIALIZER,
+};
+
 static inline int
 svc_xprt_fd_cmpf(const struct opr_rbtree_node *lhs,
 		 const struct opr_rbtree_node *rhs)
@@ -97,6 +130,189 @@ svc_xprt_fd_cmpf(const struct opr_rbtree_node *lhs,
 	return (1);
 }
 
+/* coarse msec, as recv.ts */
+static inline uint64_t
+svc_xprt_idle_now(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &ts);
+	return (timespec_ms(&ts));
+}
+
+static inline void
+svc_xprt_idle_insert(struct rpc_dplx_rec *rec)
+{
+	if (!svc_xprt_idle.running || __svc_params->idle_timeout <= 0)
+		return;
+
+	mutex_lock(&svc_xprt_idle.mtx);
+	rec->idle_off = false;
+	timer_wheel_insert(&svc_xprt_idle.tw, &rec->idle_q,
+			   timespec_ms(&rec->recv.ts)
+			   + __svc_params->idle_timeout * 1000ULL);
+	mutex_unlock(&svc_xprt_idle.mtx);
+}
+
+/*
+ * Idempotent.  Also prevents the reaper from re-placing an xprt that
+ * it has already taken off the wheel.
+ */
+static inline void
+svc_xprt_idle_remove(struct rpc_dplx_rec *rec)
+{
+	if (rec->idle_off)
+		return;
+
+	mutex_lock(&svc_xprt_idle.mtx);
+	timer_wheel_remove(&svc_xprt_idle.tw, &rec->idle_q);
+	rec->idle_off = true;
+	mutex_unlock(&svc_xprt_idle.mtx);
+}
+
+/*
+ * Like __svc_clean_idle but event-type independent.  For now no cleanfds.
+ *
+ * Epoch section, as the expired xprts are no longer on the wheel for
+ * svc_xprt_retired() to remove.
+ */
+static void
+svc_xprt_idle_reap(struct timer_wheel_list *expired, uint64_t now)
+{
+	uint64_t timeout_ms = __svc_params->idle_timeout * 1000ULL;
+	struct timer_wheel_entry *twe;
+	struct rpc_dplx_rec *rec;
+	SVCXPRT *xprt;
+	uint64_t last;
+
+	while ((twe = TAILQ_FIRST(expired))) {
+		TAILQ_REMOVE(expired, twe, twe_q);
+		rec = opr_containerof(twe, struct rpc_dplx_rec, idle_q);
+		xprt = &rec->xprt;
+
+		if (atomic_fetch_uint16_t(&xprt->xp_flags)
+		    & SVC_XPRT_FLAG_DESTROYED)
+			continue;
+
+		last = timespec_ms(&rec->recv.ts);
+		if (last + timeout_ms <= now
+		 && xprt->xp_ops
+		 && !(xprt->xp_flags & SVC_XPRT_FLAG_UREG)) {
+			SVC_DESTROY(xprt);
+			continue;
+		}
+
+		/* received meanwhile, or not reaped for now */
+		mutex_lock(&svc_xprt_idle.mtx);
+		if (!rec->idle_off)
+			timer_wheel_insert(&svc_xprt_idle.tw, twe,
+					   (last + timeout_ms > now)
+					   ? last + timeout_ms
+					   : now + timeout_ms);
+		mutex_unlock(&svc_xprt_idle.mtx);
+	}
+}
+
+void authgss_ctx_gc_idle(void);
+
+/*
+ * Polls the epoch soon, for a first deferred free.
+ */
+void
+svc_xprt_reaper_wake(void)
+{
+	mutex_lock(&svc_xprt_idle.mtx);
+	cond_signal(&svc_xprt_idle.cv);
+	mutex_unlock(&svc_xprt_idle.mtx);
+}
+
+/*
+ * Transports are reaped at most SVC_XPRT_REAP_MS late:  inserts do not
+ * wake the reaper.  While frees are deferred, the reaper also polls
+ * the epoch (in svc_epoch_exit), in case no other section exits.
+ */
+static void *
+svc_xprt_reaper(void *arg)
+{
+	struct timer_wheel_list expired;
+	struct timespec ts;
+#ifdef _HAVE_GSSAPI
+	uint64_t gc_ms = 0;
+#endif /* _HAVE_GSSAPI */
+	uint64_t now;
+	int wait_ms;
+
+	mutex_lock(&svc_xprt_idle.mtx);
+	while (!svc_xprt_idle.shutdown) {
+		mutex_unlock(&svc_xprt_idle.mtx);
+		now = svc_xprt_idle_now();
+
+#ifdef _HAVE_GSSAPI
+		if (now >= gc_ms) {
+			/* trim gss context cache */
+			authgss_ctx_gc_idle();
+			gc_ms = now + SVC_XPRT_REAP_MS;
+		}
+#endif /* _HAVE_GSSAPI */
+
+		TAILQ_INIT(&expired);
+		svc_epoch_enter();
+		mutex_lock(&svc_xprt_idle.mtx);
+		wait_ms = timer_wheel_expire(&svc_xprt_idle.tw, now, &expired,
+					     SVC_XPRT_REAP_MS);
+		mutex_unlock(&svc_xprt_idle.mtx);
+		svc_xprt_idle_reap(&expired, now);
+		svc_epoch_exit();
+
+		if (atomic_fetch_uint32_t(&svc_epoch_deferred))
+			wait_ms = MIN(wait_ms, SVC_XPRT_DEFER_MS);
+		(void)clock_gettime(CLOCK_REALTIME_FAST, &ts);
+		timespec_addms(&ts, wait_ms);
+		mutex_lock(&svc_xprt_idle.mtx);
+		if (!svc_xprt_idle.shutdown)
+			(void)cond_timedwait(&svc_xprt_idle.cv,
+					     &svc_xprt_idle.mtx, &ts);
+	}
+	mutex_unlock(&svc_xprt_idle.mtx);
+	return (NULL);
+}
+
+static void
+svc_xprt_reaper_start(void)
+{
+	int code;
+
+	/* also needed for deferred frees, without idle_timeout */
+	timer_wheel_init(&svc_xprt_idle.tw, svc_xprt_idle_now());
+	svc_xprt_idle.shutdown = false;
+
+	code = pthread_create(&svc_xprt_idle.reaper, NULL, svc_xprt_reaper,
+			      NULL);
+	if (code) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: pthread_create failed (%d)",
+			__func__, code);
+		return;
+	}
+	svc_xprt_idle.running = true;
+}
+
+static void
+svc_xprt_reaper_stop(void)
+{
+	mutex_lock(&svc_xprt_idle.mtx);
+	if (!svc_xprt_idle.running) {
+		mutex_unlock(&svc_xprt_idle.mtx);
+		return;
+	}
+	svc_xprt_idle.running = false;
+	svc_xprt_idle.shutdown = true;
+	cond_signal(&svc_xprt_idle.cv);
+	mutex_unlock(&svc_xprt_idle.mtx);
+
+	(void)pthread_join(svc_xprt_idle.reaper, NULL);
+}
+
 int
 svc_xprt_init(void)
 {
@@ -116,6 +332,11 @@ svc_xprt_init(void)
 		__warnx(TIRPC_DEBUG_FLAG_SVC_XPRT,
 			"svc_xprt_init: rbtx_init failed");
 
+	svc_xprt_fd.nfds = MIN(__rpc_dtbsize(), SVC_XPRT_FD_MAX);
+	svc_xprt_fd.fds = mem_zalloc(svc_xprt_fd.nfds *
+				     sizeof(struct rpc_dplx_rec *));
+	svc_xprt_reaper_start();
+
 	initialized = true;
 
  unlock:
@@ -131,6 +352,68 @@ svc_xprt_init_failure(void)
 	return (svc_xprt_init() != 0);
 }
 
+/*
+ * Partition locked
+ */
+static inline void
+svc_xprt_fd_publish(struct rpc_dplx_rec *rec)
+{
+	int fd = rec->xprt.xp_fd;
+
+	if (fd >= 0 && fd < svc_xprt_fd.nfds)
+		atomic_store_voidptr((void **)&svc_xprt_fd.fds[fd], rec);
+}
+
+/*
+ * Partition locked.  A later transport on the same fd may have
+ * replaced this one already.
+ */
+static inline void
+svc_xprt_fd_unpublish(struct rpc_dplx_rec *rec)
+{
+	int fd = rec->xprt.xp_fd;
+
+	if (fd >= 0 && fd < svc_xprt_fd.nfds
+	 && atomic_fetch_voidptr((void **)&svc_xprt_fd.fds[fd]) == rec)
+		atomic_store_voidptr((void **)&svc_xprt_fd.fds[fd], NULL);
+}
+
+/*
+ * Existing transport without locks, or NULL to take the tree path:
+ * not in the table, or still being set up by its creator.
+ */
+static inline SVCXPRT *
+svc_xprt_lookup_fd(int fd, bool *found)
+{
+	struct rpc_dplx_rec *rec;
+	SVCXPRT *xprt;
+
+	svc_epoch_enter();
+	rec = atomic_fetch_voidptr((void **)&svc_xprt_fd.fds[fd]);
+	*found = !!rec;
+	if (!rec
+	 || (atomic_fetch_uint16_t(&rec->xprt.xp_flags)
+	     & SVC_XPRT_FLAG_INITIAL)) {
+		svc_epoch_exit();
+		return (NULL);
+	}
+	xprt = &rec->xprt;
+
+	/* reference within the epoch ensures the destroy task waits */
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+	svc_epoch_exit();
+
+	if (!(atomic_fetch_uint16_t(&xprt->xp_flags)
+	      & SVC_XPRT_FLAG_DESTROYED)) {
+		/* do not return destroyed xprts */
+		return (xprt);
+	}
+
+	SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+	*found = false;
+	return (NULL);
+}
+
 /*
  * On success, returns with RPC_DPLX_LOCKED
  */
@@ -143,10 +426,19 @@ svc_xprt_lookup(int fd, svc_xprt_setup_t setup)
 	struct opr_rbtree_node *nv;
 	SVCXPRT *xprt = NULL;
 	uint16_t xp_flags;
+	bool found;
 
 	if (svc_xprt_init_failure())
 		return (NULL);
 
+	if (likely(fd >= 0 && fd < svc_xprt_fd.nfds)) {
+		xprt = svc_xprt_lookup_fd(fd, &found);
+		if (xprt)
+			return (xprt);
+		if (!found && !setup)
+			return (NULL);
+	}
+
 	sk.xprt.xp_fd = fd;
 	t = rbtx_partition_of_scalar(&svc_xprt_fd.xt, fd);
 
@@ -187,6 +479,9 @@ svc_xprt_lookup(int fd, svc_xprt_setup_t setup)
 					__func__);
 				(*setup)(&xprt);	/* free, sets NULL */
 				atomic_dec_uint32_t(&svc_xprt_fd.connections);
+			} else {
+				svc_xprt_fd_publish(rec);
+				svc_xprt_idle_insert(rec);
 			}
 			rwlock_unlock(&t->lock);
 			return (xprt);
@@ -245,10 +540,56 @@ svc_xprt_clear(SVCXPRT *xprt)
 		atomic_dec_uint32_t(&svc_xprt_fd.connections);
 		rwlock_wrlock(&t->lock);
 		opr_rbtree_remove(&t->t, &REC_XPRT(xprt)->fd_node);
+		svc_xprt_fd_unpublish(REC_XPRT(xprt));
 		rwlock_unlock(&t->lock);
 	}
+	svc_xprt_idle_remove(REC_XPRT(xprt));
 }
 
+/**
+ * Before freeing:  true once the xprt is unreferenced, and neither
+ * lookups nor epoch sections can reach it.  Otherwise, the destroy
+ * task (ioq_wpe) has been queued to try again.
+ */
+bool
+svc_xprt_retired(SVCXPRT *xprt)
+{
+	struct rpc_dplx_rec *rec = REC_XPRT(xprt);
+	struct rbtree_x_part *t;
+
+	if (atomic_fetch_int32_t(&xprt->xp_refcnt)) {
+		/* referenced again, stamp after the next release */
+		rec->retire_epoch = 0;
+		/* instead of nanosleep */
+		work_pool_submit(&svc_work_pool, &rec->ioq.ioq_wpe);
+		return (false);
+	}
+
+	if (unlikely(!initialized))
+		return (true);
+
+	svc_xprt_idle_remove(rec);
+
+	if (unlikely(xprt->xp_fd >= 0 && xprt->xp_fd < svc_xprt_fd.nfds
+	 && atomic_fetch_voidptr((void **)&svc_xprt_fd.fds[xprt->xp_fd])
+	    == rec)) {
+		/* released without unregistering */
+		t = rbtx_partition_of_scalar(&svc_xprt_fd.xt, xprt->xp_fd);
+		rwlock_wrlock(&t->lock);
+		svc_xprt_fd_unpublish(rec);
+		rwlock_unlock(&t->lock);
+	}
+
+	if (!rec->retire_epoch)
+		rec->retire_epoch = svc_epoch_stamp();
+	else if (svc_epoch_passed(rec->retire_epoch))
+		return (true);
+
+	/* batched with other deferred frees */
+	if (svc_epoch_defer(&rec->ioq.ioq_wpe))
+		svc_xprt_reaper_wake();
+	return (false);
+}
 int
 svc_xprt_foreach(svc_xprt_each_func_t each_f, void *arg)
 {
@@ -359,6 +700,8 @@ svc_xprt_shutdown()
 	if (!initialized)
 		return;
 
+	svc_xprt_reaper_stop();
+
 	p_ix = 0;
 	while (p_ix < SVC_XPRT_PARTITIONS) {
 		t = &svc_xprt_fd.xt.tree[p_ix];
@@ -369,6 +712,7 @@ svc_xprt_shutdown()
 
 			/* prevent repeats, see svc_xprt_clear() */
 			opr_rbtree_remove(&t->t, &rec->fd_node);
+			svc_xprt_fd_unpublish(rec);
 
 			/* fd_node is counted by initial xp_refcnt = 1,
 			 * SVC_DESTROY() decrements that reference.
@@ -385,6 +729,10 @@ svc_xprt_shutdown()
 	/* free tree */
 	mem_free(svc_xprt_fd.xt.tree,
 		 SVC_XPRT_PARTITIONS * sizeof(struct rbtree_x_part));
+	p_ix = svc_xprt_fd.nfds;
+	svc_xprt_fd.nfds = 0;
+	mem_free(svc_xprt_fd.fds, p_ix * sizeof(struct rpc_dplx_rec *));
+	svc_xprt_fd.fds = NULL;
 }
 
 void
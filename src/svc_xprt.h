@@ -44,6 +44,7 @@
  *  svc_xprt_init -- init module; usually called by svc_init()
  *  svc_xprt_lookup -- find or create shared fd state
  *  svc_xprt_clear -- remove a transport
+ *  svc_xprt_retired -- transport can be freed
  *  svc_xprt_foreach -- scan registered transports
  *  svc_xprt_dump_xprts -- dump registered transports
  *  svc_xprt_shutdown -- clear the tree, destroy transports
@@ -58,6 +59,8 @@ typedef void (*svc_xprt_setup_t) (SVCXPRT **);
  */
 SVCXPRT *svc_xprt_lookup(int, svc_xprt_setup_t);
 void svc_xprt_clear(SVCXPRT *);
+bool svc_xprt_retired(SVCXPRT *);
+void svc_xprt_reaper_wake(void);
 
 typedef bool(*svc_xprt_each_func_t) (SVCXPRT *, void *);
 int svc_xprt_foreach(svc_xprt_each_func_t, void *);
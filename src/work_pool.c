@@ -33,6 +33,11 @@
  *
  * This provides simple work queues using pthreads and TAILQ primitives.
  *
+ * Work submitted by a worker thread is queued on that worker's local
+ * queue, without touching the pool mutex.  Idle workers steal from the
+ * local queues of busy workers.  Work submitted from outside the pool,
+ * or overflowing a local queue, uses the pool head (global) queue.
+ *
  * @note    Loosely based upon previous thrdpool by
  *          Matt Benjamin <matt@cohortfs.com>
  */
@@ -55,11 +60,197 @@
 #include <string.h>
 #include <errno.h>
 #include <intrinsic.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <pthread.h>
+#endif
 
 #include <rpc/work_pool.h>
 
 #define WORK_POOL_STACK_SIZE MAX(1 * 1024 * 1024, PTHREAD_STACK_MIN)
 #define WORK_POOL_TIMEOUT_MS (31 /* seconds (prime) */ * 1000)
+#define WORK_POOL_LOCALQ_MAX (64)
+
+/* the worker context of the current thread, if any */
+static __thread struct work_pool_thread *work_pool_self;
+
+/*
+ * CPU topology, from the initial (process) affinity and sysfs.  Without
+ * sysfs, all allowed CPUs are node 0.
+ */
+#define WORK_POOL_NODES_MAX 64
+
+static struct {
+	pthread_once_t once;
+	int32_t n_cpus;			/* allowed */
+	int32_t n_nodes;		/* with allowed CPUs */
+	int32_t *cpus;			/* allowed CPU numbers */
+	int32_t *cpu_node;		/* node by CPU number */
+	int32_t cpu_max;		/* cpu_node entries */
+#if defined(__linux__)
+	cpu_set_t allowed;
+	cpu_set_t node_cpus[WORK_POOL_NODES_MAX];
+#endif
+} work_pool_topo = {
+	.once = PTHREAD_ONCE_INIT,
+};
+
+#if defined(__linux__)
+/* parse a sysfs cpulist, such as "0-3,8-11" */
+static void
+work_pool_cpulist(const char *path, cpu_set_t *set)
+{
+	char buf[1024];
+	char *p = buf;
+	FILE *fp;
+	long first;
+	long last;
+
+	CPU_ZERO(set);
+	fp = fopen(path, "r");
+	if (!fp)
+		return;
+	if (!fgets(buf, sizeof(buf), fp))
+		buf[0] = '\0';
+	fclose(fp);
+
+	while (*p >= '0' && *p <= '9') {
+		first = last = strtol(p, &p, 10);
+		if (*p == '-')
+			last = strtol(p + 1, &p, 10);
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, set);
+		if (*p == ',')
+			p++;
+	}
+}
+#endif
+
+static void
+work_pool_topo_init(void)
+{
+#if defined(__linux__)
+	char path[64];
+	cpu_set_t set;
+	int32_t node;
+	int32_t cpu;
+
+	if (sched_getaffinity(0, sizeof(work_pool_topo.allowed),
+			      &work_pool_topo.allowed)) {
+		CPU_ZERO(&work_pool_topo.allowed);
+		CPU_SET(0, &work_pool_topo.allowed);
+	}
+
+	work_pool_topo.cpu_max = CPU_SETSIZE;
+	work_pool_topo.cpus = mem_calloc(CPU_SETSIZE, sizeof(int32_t));
+	work_pool_topo.cpu_node = mem_calloc(CPU_SETSIZE, sizeof(int32_t));
+
+	for (node = 0; node < WORK_POOL_NODES_MAX; node++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%" PRId32 "/cpulist",
+			 node);
+		work_pool_cpulist(path, &set);
+		CPU_AND(&set, &set, &work_pool_topo.allowed);
+		if (!CPU_COUNT(&set))
+			continue;
+
+		/* nodes are renumbered densely */
+		work_pool_topo.node_cpus[work_pool_topo.n_nodes] = set;
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &set))
+				work_pool_topo.cpu_node[cpu] =
+					work_pool_topo.n_nodes;
+		}
+		work_pool_topo.n_nodes++;
+	}
+
+	if (!work_pool_topo.n_nodes) {
+		work_pool_topo.node_cpus[0] = work_pool_topo.allowed;
+		work_pool_topo.n_nodes = 1;
+	}
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &work_pool_topo.allowed))
+			work_pool_topo.cpus[work_pool_topo.n_cpus++] = cpu;
+	}
+#else
+	work_pool_topo.n_cpus = 0;
+	work_pool_topo.n_nodes = 0;
+#endif
+}
+
+/**
+ * @brief CPU for a (channel or worker) index, round robin over the
+ * CPUs allowed at startup.
+ *
+ * @return CPU number, or -1 when unknown
+ */
+int32_t
+work_pool_cpu(uint32_t index)
+{
+	pthread_once(&work_pool_topo.once, work_pool_topo_init);
+
+	if (!work_pool_topo.n_cpus)
+		return (-1);
+	return (work_pool_topo.cpus[index % work_pool_topo.n_cpus]);
+}
+
+/**
+ * @brief NUMA node of a CPU (numbered from 0, over nodes with allowed
+ * CPUs).
+ *
+ * @return node, or -1 when unknown
+ */
+int32_t
+work_pool_cpu_node(int32_t cpu)
+{
+	pthread_once(&work_pool_topo.once, work_pool_topo_init);
+
+	if (cpu < 0 || cpu >= work_pool_topo.cpu_max)
+		return (-1);
+	return (work_pool_topo.cpu_node[cpu]);
+}
+
+/**
+ * @brief Bind a new worker, per the pool flags
+ */
+static void
+work_pool_bind(struct work_pool *pool, struct work_pool_thread *wpt)
+{
+	uint32_t index = wpt->worker_index - 1;
+
+	wpt->cpu = -1;
+	wpt->node = -1;
+
+	if (!(pool->params.flags & (WORK_POOL_FLAG_CPU | WORK_POOL_FLAG_NUMA)))
+		return;
+
+	pthread_once(&work_pool_topo.once, work_pool_topo_init);
+
+#if defined(__linux__)
+	if (!work_pool_topo.n_cpus)
+		return;
+
+	if (pool->params.flags & WORK_POOL_FLAG_CPU) {
+		cpu_set_t set;
+
+		wpt->cpu = work_pool_cpu(index);
+		wpt->node = work_pool_cpu_node(wpt->cpu);
+		CPU_ZERO(&set);
+		CPU_SET(wpt->cpu, &set);
+		(void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	} else {
+		wpt->node = index % work_pool_topo.n_nodes;
+		(void)pthread_setaffinity_np(pthread_self(),
+				sizeof(cpu_set_t),
+				&work_pool_topo.node_cpus[wpt->node]);
+	}
+
+	__warnx(TIRPC_DEBUG_FLAG_WORKER,
+		"%s() %s cpu %" PRId32 " node %" PRId32,
+		__func__, wpt->worker_name, wpt->cpu, wpt->node);
+#endif
+}
 
 /* forward declaration in lieu of moving code, was inline */
 
@@ -69,6 +260,7 @@ int
 work_pool_init(struct work_pool *pool, const char *name,
 		struct work_pool_params *params)
 {
+	uint32_t ix;
 	int rc;
 
 	memset(pool, 0, sizeof(*pool));
@@ -94,6 +286,12 @@ work_pool_init(struct work_pool *pool, const char *name,
 		pool->params.thrd_max = pool->params.thrd_min;
 	};
 
+	pool->n_localq = pool->params.thrd_max;
+	pool->localq = mem_calloc(pool->n_localq,
+				  sizeof(struct work_pool_localq));
+	for (ix = 0; ix < pool->n_localq; ix++)
+		poolq_head_setup(&pool->localq[ix].pqh);
+
 	rc = pthread_attr_init(&pool->attr);
 	if (rc) {
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
@@ -130,12 +328,169 @@ work_pool_init(struct work_pool *pool, const char *name,
 	return work_pool_spawn(pool);
 }
 
+/**
+ * @brief Take work from a local queue
+ *
+ * @param[in] lq	local queue
+ *
+ * @return oldest entry, or NULL
+ */
+static inline struct work_pool_entry *
+work_pool_localq_get(struct work_pool_localq *lq)
+{
+	struct poolq_entry *have;
+
+	/* unlocked test avoids contending for empty queues */
+	if (atomic_fetch_int32_t(&lq->pqh.qcount) <= 0)
+		return (NULL);
+
+	pthread_mutex_lock(&lq->pqh.qmutex);
+	have = TAILQ_FIRST(&lq->pqh.qh);
+	if (have) {
+		TAILQ_REMOVE(&lq->pqh.qh, have, q);
+		lq->pqh.qcount--;
+	}
+	pthread_mutex_unlock(&lq->pqh.qmutex);
+
+	return ((struct work_pool_entry *)have);
+}
+
+/**
+ * @brief Steal work from the local queue of another worker
+ *
+ * @param[in] pool	work pool
+ * @param[in] wpt	thief
+ *
+ * @return entry, or NULL
+ */
+static struct work_pool_entry *
+work_pool_steal(struct work_pool *pool, struct work_pool_thread *wpt)
+{
+	struct work_pool_entry *work;
+	uint32_t start = wpt->localq - pool->localq;
+	uint32_t ix;
+
+	/* begin after our own queue, spreading the thieves */
+	for (ix = 1; ix < pool->n_localq; ix++) {
+		work = work_pool_localq_get(
+			&pool->localq[(start + ix) % pool->n_localq]);
+		if (work)
+			return (work);
+	}
+	return (NULL);
+}
+
+/**
+ * @brief Claim a local queue for a new worker
+ *
+ * @note pool mutex is held
+ */
+static void
+work_pool_localq_attach(struct work_pool *pool, struct work_pool_thread *wpt)
+{
+	uint32_t ix;
+
+	for (ix = 0; ix < pool->n_localq; ix++) {
+		if (!pool->localq[ix].wpt) {
+			pool->localq[ix].wpt = wpt;
+			wpt->localq = &pool->localq[ix];
+			return;
+		}
+	}
+
+	/* cannot happen, n_threads is limited by thrd_max */
+	__warnx(TIRPC_DEBUG_FLAG_ERROR,
+		"%s() %s no local queue available",
+		__func__, pool->name);
+	abort();
+}
+
+/**
+ * @brief Release a local queue, moving any remaining work to the pool
+ *
+ * @note pool mutex is held
+ */
+static void
+work_pool_localq_detach(struct work_pool *pool, struct work_pool_thread *wpt)
+{
+	struct work_pool_localq *lq = wpt->localq;
+	struct poolq_entry *have;
+
+	pthread_mutex_lock(&lq->pqh.qmutex);
+	while ((have = TAILQ_FIRST(&lq->pqh.qh))) {
+		TAILQ_REMOVE(&lq->pqh.qh, have, q);
+		lq->pqh.qcount--;
+
+		if (0 < pool->pqh.qcount--) {
+			struct work_pool_thread *waiting =
+				(struct work_pool_thread *)
+				TAILQ_FIRST(&pool->pqh.qh);
+
+			TAILQ_REMOVE(&pool->pqh.qh, &waiting->pqe, q);
+			waiting->work = (struct work_pool_entry *)have;
+			pthread_cond_signal(&waiting->pqcond);
+		} else {
+			TAILQ_INSERT_TAIL(&pool->pqh.qh, have, q);
+		}
+	}
+	lq->wpt = NULL;
+	pthread_mutex_unlock(&lq->pqh.qmutex);
+	wpt->localq = NULL;
+}
+
+/**
+ * @brief Dynamically add another thread, when busy
+ *
+ * @note pool mutex is held
+ */
+static inline bool
+work_pool_want_spawn(struct work_pool *pool)
+{
+	bool spawn = pool->pqh.qcount < pool->params.thrd_min
+		  && pool->n_threads < pool->params.thrd_max;
+
+	if (spawn)
+		pool->n_threads++;
+	return (spawn);
+}
+
+/**
+ * @brief Add another thread before running local or stolen work
+ *
+ * Such work bypasses the pool queue, so may be queued behind blocking
+ * tasks without any worker otherwise testing for spawn.
+ *
+ * @note pool mutex is not held
+ */
+static inline void
+work_pool_check_spawn(struct work_pool *pool)
+{
+	bool spawn;
+
+	/* unlocked test first, as this runs for each task */
+	if (atomic_fetch_int32_t(&pool->pqh.qcount) >= pool->params.thrd_min
+	 || atomic_fetch_uint32_t(&pool->n_threads)
+	    >= (uint32_t)pool->params.thrd_max)
+		return;
+
+	pthread_mutex_lock(&pool->pqh.qmutex);
+	spawn = work_pool_want_spawn(pool);
+	pthread_mutex_unlock(&pool->pqh.qmutex);
+
+	if (spawn)
+		(void)work_pool_spawn(pool);
+}
+
 /**
  * @brief The worker thread
  *
  * This is the body of the worker thread. The argument is a pointer to
  * its working context, kept in a list for each pool.
  *
+ * Work is taken from the local queue first, then from the pool (global)
+ * queue, then stolen from other workers.  Only the pool queue and
+ * waiting require the pool mutex.
+ *
  * @param[in] arg 	thread context
  */
 
@@ -152,22 +507,21 @@ work_pool_thread(void *arg)
 	pthread_cond_init(&wpt->pqcond, NULL);
 	pthread_mutex_lock(&pool->pqh.qmutex);
 	TAILQ_INSERT_TAIL(&pool->wptqh, wpt, wptq);
+	work_pool_localq_attach(pool, wpt);
 
 	wpt->worker_index = atomic_inc_uint32_t(&pool->worker_index);
 	snprintf(wpt->worker_name, sizeof(wpt->worker_name), "%.5s%" PRIu32,
 		 pool->name, wpt->worker_index);
 	__ntirpc_pkg_params.thread_name_(wpt->worker_name);
+	work_pool_bind(pool, wpt);
+	work_pool_self = wpt;
 
 	do {
 		/* testing at top of loop allows pre-specification of work,
 		 * and thread termination after timeout with no work (below).
 		 */
 		if (wpt->work) {
-			wpt->work->wpt = wpt;
-			spawn = pool->pqh.qcount < pool->params.thrd_min
-			      && pool->n_threads < pool->params.thrd_max;
-			if (spawn)
-				pool->n_threads++;
+			spawn = work_pool_want_spawn(pool);
 			pthread_mutex_unlock(&pool->pqh.qmutex);
 
 			if (spawn) {
@@ -175,11 +529,23 @@ work_pool_thread(void *arg)
 				(void)work_pool_spawn(pool);
 			}
 
-			__warnx(TIRPC_DEBUG_FLAG_WORKER,
-				"%s() %s task %p",
-				__func__, wpt->worker_name, wpt->work);
-			wpt->work->fun(wpt->work);
-			wpt->work = NULL;
+			do {
+				wpt->work->wpt = wpt;
+				__warnx(TIRPC_DEBUG_FLAG_WORKER,
+					"%s() %s task %p",
+					__func__, wpt->worker_name, wpt->work);
+				wpt->work->fun(wpt->work);
+
+				/* unlocked (by the pool) sources of work */
+				wpt->work = work_pool_localq_get(wpt->localq);
+				if (!wpt->work
+				 && atomic_fetch_int32_t(&pool->pqh.qcount)
+				    >= 0)
+					wpt->work = work_pool_steal(pool, wpt);
+				if (wpt->work)
+					work_pool_check_spawn(pool);
+			} while (wpt->work);
+
 			pthread_mutex_lock(&pool->pqh.qmutex);
 		}
 
@@ -198,6 +564,19 @@ work_pool_thread(void *arg)
 		 */
 		TAILQ_INSERT_TAIL(&pool->pqh.qh, &wpt->pqe, q);
 
+		/* Now counted as waiting, so a worker queueing locally
+		 * (after this scan) will hand its work to us instead.
+		 * Pairs with the fence in work_pool_submit_local():  the
+		 * count is stored before the local queues are loaded.
+		 */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		wpt->work = work_pool_steal(pool, wpt);
+		if (wpt->work) {
+			pool->pqh.qcount--;
+			TAILQ_REMOVE(&pool->pqh.qh, &wpt->pqe, q);
+			continue;
+		}
+
 		__warnx(TIRPC_DEBUG_FLAG_WORKER,
 			"%s() %s waiting",
 			__func__, wpt->worker_name);
@@ -229,6 +608,8 @@ work_pool_thread(void *arg)
 		}
 	} while (wpt->work || pool->pqh.qcount < pool->params.thrd_min);
 
+	work_pool_self = NULL;
+	work_pool_localq_detach(pool, wpt);
 	pool->n_threads--;
 	TAILQ_REMOVE(&pool->wptqh, wpt, wptq);
 	pthread_mutex_unlock(&pool->pqh.qmutex);
@@ -261,15 +642,81 @@ work_pool_spawn(struct work_pool *pool)
 	return (0);
 }
 
+/**
+ * @brief Queue work on the local queue of the submitting worker
+ *
+ * @param[in] pool	work pool
+ * @param[in] wpt	submitting worker
+ * @param[in] work	work entry
+ *
+ * @return true when queued, false when full
+ */
+static inline bool
+work_pool_submit_local(struct work_pool *pool, struct work_pool_thread *wpt,
+		       struct work_pool_entry *work)
+{
+	struct work_pool_localq *lq = wpt->localq;
+	struct poolq_entry *have = NULL;
+
+	pthread_mutex_lock(&lq->pqh.qmutex);
+	if (lq->pqh.qcount >= WORK_POOL_LOCALQ_MAX) {
+		pthread_mutex_unlock(&lq->pqh.qmutex);
+		return (false);
+	}
+	TAILQ_INSERT_TAIL(&lq->pqh.qh, &work->pqe, q);
+	lq->pqh.qcount++;
+	pthread_mutex_unlock(&lq->pqh.qmutex);
+
+	/* Tested after queuing: a worker that began waiting after its
+	 * last steal attempt is always seen here.  The unlock only
+	 * releases, so fence the store before this load.
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (atomic_fetch_int32_t(&pool->pqh.qcount) <= 0)
+		return (true);
+
+	pthread_mutex_lock(&pool->pqh.qmutex);
+	if (0 < pool->pqh.qcount) {
+		/* hand the newest entry (if not already stolen) directly
+		 * to a waiting worker.
+		 */
+		pthread_mutex_lock(&lq->pqh.qmutex);
+		have = TAILQ_LAST(&lq->pqh.qh, poolq_head_s);
+		if (have) {
+			TAILQ_REMOVE(&lq->pqh.qh, have, q);
+			lq->pqh.qcount--;
+		}
+		pthread_mutex_unlock(&lq->pqh.qmutex);
+	}
+	if (have) {
+		struct work_pool_thread *waiting = (struct work_pool_thread *)
+			TAILQ_FIRST(&pool->pqh.qh);
+
+		pool->pqh.qcount--;
+		TAILQ_REMOVE(&pool->pqh.qh, &waiting->pqe, q);
+		waiting->work = (struct work_pool_entry *)have;
+		pthread_cond_signal(&waiting->pqcond);
+	}
+	pthread_mutex_unlock(&pool->pqh.qmutex);
+	return (true);
+}
+
 int
 work_pool_submit(struct work_pool *pool, struct work_pool_entry *work)
 {
+	struct work_pool_thread *self = work_pool_self;
 	int rc = 0;
 
 	if (unlikely(!pool->params.thrd_max)) {
 		/* queue is draining */
 		return (0);
 	}
+
+	if (self && self->pool == pool
+	 && work_pool_submit_local(pool, self, work)) {
+		return (0);
+	}
+
 	pthread_mutex_lock(&pool->pqh.qmutex);
 
 	if (0 < pool->pqh.qcount--) {
@@ -294,6 +741,99 @@ work_pool_submit(struct work_pool *pool, struct work_pool_entry *work)
 	return rc;
 }
 
+/**
+ * @brief Take a waiting worker, preferring one bound to cpu, then node
+ *
+ * @note pool mutex is held, and qcount was positive
+ */
+static inline struct work_pool_thread *
+work_pool_waiting(struct work_pool *pool, int32_t node, int32_t cpu)
+{
+	struct work_pool_thread *wpt = (struct work_pool_thread *)
+		TAILQ_FIRST(&pool->pqh.qh);
+	struct poolq_entry *have;
+
+	if (node >= 0 || cpu >= 0) {
+		TAILQ_FOREACH(have, &pool->pqh.qh, q) {
+			struct work_pool_thread *next =
+				(struct work_pool_thread *)have;
+
+			if (cpu >= 0 && next->cpu == cpu) {
+				wpt = next;
+				break;
+			}
+			if (node >= 0 && next->node == node
+			 && wpt->node != node)
+				wpt = next;
+		}
+	}
+
+	TAILQ_REMOVE(&pool->pqh.qh, &wpt->pqe, q);
+	return (wpt);
+}
+
+/**
+ * @brief Submit a vector of work entries, near a CPU and node
+ *
+ * All entries are queued under a single pool lock.  Waiting workers are
+ * handed entries directly, so only as many workers are signalled as
+ * there are entries to run; the remainder is queued for busy workers.
+ *
+ * Waiting workers bound to node are preferred.  The last entry (such as
+ * the next event task of a channel) prefers the worker bound to cpu.
+ *
+ * @param[in] pool	work pool
+ * @param[in] works	vector of work entries, in order
+ * @param[in] count	number of entries
+ * @param[in] node	preferred node, or -1
+ * @param[in] cpu	preferred CPU of the last entry, or -1
+ */
+int
+work_pool_submit_near(struct work_pool *pool, struct work_pool_entry **works,
+		      int count, int32_t node, int32_t cpu)
+{
+	int ix;
+
+	if (unlikely(!pool->params.thrd_max)) {
+		/* queue is draining */
+		return (0);
+	}
+
+	pthread_mutex_lock(&pool->pqh.qmutex);
+
+	for (ix = 0; ix < count; ix++) {
+		if (0 < pool->pqh.qcount--) {
+			struct work_pool_thread *wpt =
+				work_pool_waiting(pool, node,
+						  ix == count - 1 ? cpu : -1);
+
+			/* positive for waiting worker(s) */
+			wpt->work = works[ix];
+			pthread_cond_signal(&wpt->pqcond);
+		} else {
+			/* negative for task(s) */
+			TAILQ_INSERT_TAIL(&pool->pqh.qh, &works[ix]->pqe, q);
+		}
+	}
+
+	pthread_mutex_unlock(&pool->pqh.qmutex);
+	return (0);
+}
+
+/**
+ * @brief Submit a vector of work entries
+ *
+ * @param[in] pool	work pool
+ * @param[in] works	vector of work entries, in order
+ * @param[in] count	number of entries
+ */
+int
+work_pool_submit_batch(struct work_pool *pool, struct work_pool_entry **works,
+		       int count)
+{
+	return (work_pool_submit_near(pool, works, count, -1, -1));
+}
+
 int
 work_pool_shutdown(struct work_pool *pool)
 {
@@ -324,6 +864,11 @@ work_pool_shutdown(struct work_pool *pool)
 	}
 	pthread_mutex_unlock(&pool->pqh.qmutex);
 
+	while (pool->n_localq > 0)
+		poolq_head_destroy(&pool->localq[--(pool->n_localq)].pqh);
+	mem_free(pool->localq, 0);
+	pool->localq = NULL;
+
 	mem_free(pool->name, 0);
 	poolq_head_destroy(&pool->pqh);
 
@@ -66,6 +66,192 @@ static uint64_t next_id;
 #endif				/* 0 */
 #define free_buffer(addr,size) mem_free((addr), size)
 
+/*
+ * Receive buffer pool
+ *
+ * Power of two size classes, each a poolq_head of whole xdr_ioq_uv
+ * (with buffer) released with UIO_FLAG_BUFQ.  Every thread keeps a few
+ * of each class without locking, fewer of the larger classes (under
+ * 1MiB in all); overflow goes to the shared class queue, then back to
+ * the allocator.
+ *
+ * Encode xdr_ioq (with first buffer) are kept the same way, see
+ * xdr_ioq_create_cached().
+ */
+#define XDR_IOQ_BUFQ_SHIFT 10		/* smallest class 1KiB */
+#define XDR_IOQ_BUFQ_CLASSES 11		/* largest class 1MiB */
+#define XDR_IOQ_BUFQ_CACHE 16		/* per thread, per class */
+#define XDR_IOQ_BUFQ_CACHE_BYTES (128 * 1024)	/* per thread, per class */
+#define XDR_IOQ_BUFQ_BYTES (8 * 1024 * 1024)	/* shared, per class */
+#define XDR_IOQ_CACHE 16		/* per thread */
+#define XDR_IOQ_SHARED 256
+
+struct xdr_ioq_bufq {
+	struct poolq_head pqh;
+	size_t size;
+	int max;
+	int cache_max;		/* per thread */
+};
+
+struct xdr_ioq_cache_q {
+	TAILQ_HEAD(, poolq_entry) qh;
+	int qcount;
+};
+
+struct xdr_ioq_cache {
+	struct xdr_ioq_cache_q bufq[XDR_IOQ_BUFQ_CLASSES];
+	struct xdr_ioq_cache_q ioqs;
+};
+
+static struct xdr_ioq_bufq xdr_ioq_bufq[XDR_IOQ_BUFQ_CLASSES];
+static struct poolq_head xdr_ioq_shared;
+static pthread_once_t xdr_ioq_cache_once = PTHREAD_ONCE_INIT;
+static thread_key_t xdr_ioq_cache_key;
+static __thread struct xdr_ioq_cache *xdr_ioq_cache_self;
+
+static void xdr_ioq_bufq_put(struct xdr_ioq_uv *uv);
+static void xdr_ioq_put(struct xdr_ioq *xioq);
+
+static void
+xdr_ioq_cache_free(void *arg)
+{
+	struct xdr_ioq_cache *cache = arg;
+	struct poolq_entry *have;
+	int ix;
+
+	/* put() sees no cache, returns to the shared queues */
+	xdr_ioq_cache_self = NULL;
+
+	for (ix = 0; ix < XDR_IOQ_BUFQ_CLASSES; ix++) {
+		while ((have = TAILQ_FIRST(&cache->bufq[ix].qh))) {
+			TAILQ_REMOVE(&cache->bufq[ix].qh, have, q);
+			xdr_ioq_bufq_put(IOQ_(have));
+		}
+	}
+	while ((have = TAILQ_FIRST(&cache->ioqs.qh))) {
+		TAILQ_REMOVE(&cache->ioqs.qh, have, q);
+		xdr_ioq_put(_IOQ(have));
+	}
+	mem_free(cache, sizeof(*cache));
+}
+
+static void
+xdr_ioq_cache_init(void)
+{
+	int ix;
+
+	for (ix = 0; ix < XDR_IOQ_BUFQ_CLASSES; ix++) {
+		poolq_head_setup(&xdr_ioq_bufq[ix].pqh);
+		xdr_ioq_bufq[ix].size = 1 << (XDR_IOQ_BUFQ_SHIFT + ix);
+		xdr_ioq_bufq[ix].max = XDR_IOQ_BUFQ_BYTES
+				     / xdr_ioq_bufq[ix].size;
+		xdr_ioq_bufq[ix].cache_max =
+			MIN(XDR_IOQ_BUFQ_CACHE, XDR_IOQ_BUFQ_CACHE_BYTES
+						/ xdr_ioq_bufq[ix].size);
+	}
+	poolq_head_setup(&xdr_ioq_shared);
+	thr_keycreate(&xdr_ioq_cache_key, xdr_ioq_cache_free);
+}
+
+static inline struct xdr_ioq_cache *
+xdr_ioq_cache(void)
+{
+	struct xdr_ioq_cache *cache = xdr_ioq_cache_self;
+	int ix;
+
+	if (likely(cache))
+		return (cache);
+
+	cache = mem_zalloc(sizeof(*cache));
+	for (ix = 0; ix < XDR_IOQ_BUFQ_CLASSES; ix++)
+		TAILQ_INIT(&cache->bufq[ix].qh);
+	TAILQ_INIT(&cache->ioqs.qh);
+	thr_setspecific(xdr_ioq_cache_key, cache);
+	xdr_ioq_cache_self = cache;
+	return (cache);
+}
+
+static void
+xdr_ioq_bufq_put(struct xdr_ioq_uv *uv)
+{
+	struct xdr_ioq_bufq *bq = uv->u.uio_u1;
+	struct xdr_ioq_cache *cache = xdr_ioq_cache_self;
+	int ix = bq - xdr_ioq_bufq;
+
+	if (likely(cache && cache->bufq[ix].qcount < bq->cache_max)) {
+		TAILQ_INSERT_HEAD(&cache->bufq[ix].qh, &uv->uvq, q);
+		(cache->bufq[ix].qcount)++;
+		return;
+	}
+
+	pthread_mutex_lock(&bq->pqh.qmutex);
+	if (bq->pqh.qcount < bq->max) {
+		TAILQ_INSERT_HEAD(&bq->pqh.qh, &uv->uvq, q);
+		(bq->pqh.qcount)++;
+		pthread_mutex_unlock(&bq->pqh.qmutex);
+		return;
+	}
+	pthread_mutex_unlock(&bq->pqh.qmutex);
+
+	free_buffer(uv->v.vio_base, bq->size);
+	mem_free(uv, sizeof(*uv));
+}
+
+/*
+ * Get a buffer of (at least) size from the receive buffer pool.
+ *
+ * The vector is limited to size, so that the result is interchangeable
+ * with xdr_ioq_uv_create().  Larger sizes are allocated directly.
+ */
+struct xdr_ioq_uv *
+xdr_ioq_uv_bufq_create(size_t size, u_int uio_flags)
+{
+	struct xdr_ioq_cache *cache;
+	struct poolq_entry *have;
+	struct xdr_ioq_bufq *bq;
+	struct xdr_ioq_uv *uv;
+	int ix = 0;
+
+	if (unlikely(size > (1 << (XDR_IOQ_BUFQ_SHIFT
+				   + XDR_IOQ_BUFQ_CLASSES - 1))))
+		return (xdr_ioq_uv_create(size, uio_flags));
+
+	pthread_once(&xdr_ioq_cache_once, xdr_ioq_cache_init);
+
+	while (size > (1 << (XDR_IOQ_BUFQ_SHIFT + ix)))
+		ix++;
+	bq = &xdr_ioq_bufq[ix];
+	cache = xdr_ioq_cache();
+
+	have = TAILQ_FIRST(&cache->bufq[ix].qh);
+	if (likely(have)) {
+		TAILQ_REMOVE(&cache->bufq[ix].qh, have, q);
+		(cache->bufq[ix].qcount)--;
+	} else {
+		pthread_mutex_lock(&bq->pqh.qmutex);
+		have = TAILQ_FIRST(&bq->pqh.qh);
+		if (have) {
+			TAILQ_REMOVE(&bq->pqh.qh, have, q);
+			(bq->pqh.qcount)--;
+		}
+		pthread_mutex_unlock(&bq->pqh.qmutex);
+	}
+
+	if (have) {
+		uv = IOQ_(have);
+	} else {
+		uv = xdr_ioq_uv_create(bq->size, UIO_FLAG_NONE);
+		uv->u.uio_p1 = &bq->pqh;
+		uv->u.uio_u1 = bq;
+	}
+
+	uv->v.vio_head = uv->v.vio_base;
+	uv->v.vio_tail = uv->v.vio_base;
+	uv->v.vio_wrap = uv->v.vio_base + size;
+	uv->u.uio_flags = (uio_flags & ~UIO_FLAG_FREE) | UIO_FLAG_BUFQ;
+	return (uv);
+}
+
 struct xdr_ioq_uv *
 xdr_ioq_uv_create(size_t size, u_int uio_flags)
 {
@@ -203,7 +389,10 @@ xdr_ioq_uv_release(struct xdr_ioq_uv *uv)
 			mem_free(uv, sizeof(*uv));
 		} else if (uv->u.uio_flags & UIO_FLAG_BUFQ) {
 			uv->u.uio_references = 1;	/* keeping one */
-			xdr_ioq_uv_recycle(uv->u.uio_p1, &uv->uvq);
+			if (uv->u.uio_u1)
+				xdr_ioq_bufq_put(uv);
+			else
+				xdr_ioq_uv_recycle(uv->u.uio_p1, &uv->uvq);
 		} else {
 			__warnx(TIRPC_DEBUG_FLAG_ERROR,
 				"%s() memory leak, no release flags (%u)\n",
@@ -307,6 +496,130 @@ xdr_ioq_create(size_t min_bsize, size_t max_bsize, u_int uio_flags)
 	return (xioq);
 }
 
+/*
+ * Like xdr_ioq_create(), for encoding replies and calls.
+ *
+ * The xdr_ioq (with its mutex and condition) and first buffer are taken
+ * from the per-thread cache, or the shared queue, and are returned there
+ * by xdr_ioq_destroy().
+ */
+struct xdr_ioq *
+xdr_ioq_create_cached(size_t min_bsize, size_t max_bsize, u_int uio_flags)
+{
+	struct xdr_ioq_cache *cache;
+	struct poolq_entry *have;
+	struct xdr_ioq_uv *uv = NULL;
+	struct xdr_ioq *xioq;
+
+	pthread_once(&xdr_ioq_cache_once, xdr_ioq_cache_init);
+	cache = xdr_ioq_cache();
+
+	have = TAILQ_FIRST(&cache->ioqs.qh);
+	if (likely(have)) {
+		TAILQ_REMOVE(&cache->ioqs.qh, have, q);
+		(cache->ioqs.qcount)--;
+	} else {
+		pthread_mutex_lock(&xdr_ioq_shared.qmutex);
+		have = TAILQ_FIRST(&xdr_ioq_shared.qh);
+		if (have) {
+			TAILQ_REMOVE(&xdr_ioq_shared.qh, have, q);
+			(xdr_ioq_shared.qcount)--;
+		}
+		pthread_mutex_unlock(&xdr_ioq_shared.qmutex);
+	}
+
+	if (unlikely(!have)) {
+		xioq = xdr_ioq_create(min_bsize, max_bsize, uio_flags);
+		xioq->ioq_s.qflags |= IOQ_FLAG_RECYCLE;
+		return (xioq);
+	}
+	xioq = _IOQ(have);
+
+	/* as xdr_ioq_setup() */
+	xioq->xdrs[0].x_op = XDR_ENCODE;
+	xioq->xdrs[0].x_public = NULL;
+	xioq->xdrs[0].x_private = NULL;
+	xioq->xdrs[0].x_lib[0] = NULL;
+	xioq->xdrs[0].x_lib[1] = NULL;
+	xioq->xdrs[0].x_flags = XDR_FLAG_VIO | XDR_FLAG_FREE;
+	xioq->ioq_uv.min_bsize = min_bsize;
+	xioq->ioq_uv.max_bsize = max_bsize;
+	xioq->id = atomic_inc_uint64_t(&next_id);
+
+	have = TAILQ_FIRST(&xioq->ioq_uv.uvqh.qh);
+	if (have) {
+		uv = IOQ_(have);
+		if (unlikely((uio_flags & UIO_FLAG_REALLOC)
+			     || ioquv_size(uv) != min_bsize)) {
+			TAILQ_REMOVE(&xioq->ioq_uv.uvqh.qh, have, q);
+			(xioq->ioq_uv.uvqh.qcount)--;
+			xdr_ioq_uv_release(uv);
+			uv = NULL;
+		}
+	}
+
+	if (uv) {
+		uv->v.vio_head = uv->v.vio_base;
+		uv->v.vio_tail = uv->v.vio_base;
+		uv->u.uio_flags = uio_flags;
+	} else {
+		uv = xdr_ioq_uv_create(min_bsize, uio_flags);
+		xioq->ioq_uv.uvqh.qcount = 1;
+		TAILQ_INSERT_HEAD(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
+	}
+	xdr_ioq_reset(xioq, 0);
+
+	return (xioq);
+}
+
+static void
+xdr_ioq_put(struct xdr_ioq *xioq)
+{
+	struct xdr_ioq_cache *cache = xdr_ioq_cache_self;
+	struct poolq_entry *have = TAILQ_FIRST(&xioq->ioq_uv.uvqh.qh);
+	struct xdr_ioq_uv *uv = NULL;
+
+	/* keep the first buffer, unless it was grown or is shared */
+	if (have) {
+		uv = IOQ_(have);
+		if (likely(uv->u.uio_references == 1
+			   && !uv->u.uio_refer
+			   && !uv->u.uio_release
+			   && (uv->u.uio_flags
+			       & (UIO_FLAG_FREE | UIO_FLAG_REALLOC))
+			      == UIO_FLAG_FREE)) {
+			TAILQ_REMOVE(&xioq->ioq_uv.uvqh.qh, have, q);
+			(xioq->ioq_uv.uvqh.qcount)--;
+		} else {
+			uv = NULL;
+		}
+	}
+	xdr_ioq_release(&xioq->ioq_uv.uvqh);
+
+	if (uv) {
+		xioq->ioq_uv.uvqh.qcount = 1;
+		TAILQ_INSERT_HEAD(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
+	}
+
+	if (likely(cache && cache->ioqs.qcount < XDR_IOQ_CACHE)) {
+		TAILQ_INSERT_HEAD(&cache->ioqs.qh, &xioq->ioq_s, q);
+		(cache->ioqs.qcount)++;
+		return;
+	}
+
+	pthread_mutex_lock(&xdr_ioq_shared.qmutex);
+	if (xdr_ioq_shared.qcount < XDR_IOQ_SHARED) {
+		TAILQ_INSERT_HEAD(&xdr_ioq_shared.qh, &xioq->ioq_s, q);
+		(xdr_ioq_shared.qcount)++;
+		pthread_mutex_unlock(&xdr_ioq_shared.qmutex);
+		return;
+	}
+	pthread_mutex_unlock(&xdr_ioq_shared.qmutex);
+
+	xioq->ioq_s.qflags &= ~IOQ_FLAG_RECYCLE;
+	xdr_ioq_destroy(xioq, sizeof(*xioq));
+}
+
 /*
  * Advance read/insert or fill position.
  *
@@ -714,6 +1027,11 @@ xdr_ioq_destroy(struct xdr_ioq *xioq, size_t qsize)
 		"%s() xioq %p",
 		__func__, xioq);
 
+	if (xioq->ioq_s.qflags & IOQ_FLAG_RECYCLE) {
+		xdr_ioq_put(xioq);
+		return;
+	}
+
 	xdr_ioq_release(&xioq->ioq_uv.uvqh);
 
 	if (xioq->ioq_pool) {
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2019 Red Hat, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file xdr_swap.h
+ * @brief Bulk decode of XDR units
+ *
+ * The instruction set is selected at compile time, as city.c does for
+ * SSE4.2.  Loads are unaligned:  buffers are only aligned to an XDR
+ * unit.
+ */
+
+#ifndef XDR_SWAP_H
+#define XDR_SWAP_H
+
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include <arpa/inet.h>
+
+#if __BYTE_ORDER != __BIG_ENDIAN
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#endif
+
+/*
+ * Decode n unsigned units from src to host order.
+ */
+static inline void
+xdr_units_ntoh(uint32_t *dst, const void *src, unsigned int n)
+{
+	const uint8_t *p = src;
+	unsigned int ix = 0;
+
+	/* big endian:  network order, ntohl() is free */
+#if __BYTE_ORDER != __BIG_ENDIAN
+#if defined(__AVX2__)
+	const __m256i rev8 = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	for (; ix + 8 <= n; ix += 8)
+		_mm256_storeu_si256((__m256i *)(dst + ix),
+			_mm256_shuffle_epi8(
+				_mm256_loadu_si256((const __m256i *)(p + ix * 4)),
+				rev8));
+#endif
+#if defined(__SSSE3__)
+	const __m128i rev = _mm_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	for (; ix + 4 <= n; ix += 4)
+		_mm_storeu_si128((__m128i *)(dst + ix),
+			_mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(p + ix * 4)),
+				rev));
+#elif defined(__SSE2__)
+	__m128i v;
+
+	for (; ix + 4 <= n; ix += 4) {
+		v = _mm_loadu_si128((const __m128i *)(p + ix * 4));
+		/* swap bytes within halfwords, then halfwords within words */
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		_mm_storeu_si128((__m128i *)(dst + ix), v);
+	}
+#elif defined(__ARM_NEON)
+	for (; ix + 4 <= n; ix += 4)
+		vst1q_u8((uint8_t *)(dst + ix),
+			 vrev32q_u8(vld1q_u8(p + ix * 4)));
+#endif
+#endif
+	for (; ix < n; ix++) {
+		memcpy(&dst[ix], p + ix * 4, sizeof(uint32_t));
+		dst[ix] = ntohl(dst[ix]);
+	}
+}
+
+#endif				/* XDR_SWAP_H */